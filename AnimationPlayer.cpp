@@ -0,0 +1,137 @@
+#include "AnimationPlayer.h"
+#include <QImageReader>
+#include <QMutexLocker>
+#include "MappedFile.h"
+
+namespace {
+// Enough to ride out a slow frame without holding more than a few screens of pixels
+const int kBufferedFrames = 6;
+// Delays this short are treated the way browsers do, otherwise such GIFs race
+const int kMinFrameDelayMs = 20;
+const int kDefaultFrameDelayMs = 100;
+// How long playback waits before checking again when the decoder fell behind
+const int kUnderrunRetryMs = 5;
+}
+
+AnimationPlayer::AnimationPlayer(QObject* parent)
+    : QObject(parent), m_decoder(nullptr), m_decoderFinished(false), m_stopRequested(0) {
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_frameTimer, &QTimer::timeout, this, &AnimationPlayer::showNextFrame);
+}
+
+AnimationPlayer::~AnimationPlayer() {
+    stop();
+}
+
+void AnimationPlayer::start(const QString& path) {
+    stop();
+    m_stopRequested.storeRelease(0);
+    m_decoderFinished = false;
+    m_decoder = QThread::create([this, path]() { decodeLoop(path); });
+    m_decoder->start(QThread::LowPriority);
+    m_frameTimer.start(0);
+}
+
+void AnimationPlayer::stop() {
+    m_frameTimer.stop();
+    if (!m_decoder) return;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopRequested.storeRelease(1);
+        m_notFull.wakeAll();
+    }
+    m_decoder->wait(); // Reads are cancelled through the device, so this returns within a frame
+    delete m_decoder;
+    m_decoder = nullptr;
+    m_frames.clear();
+}
+
+void AnimationPlayer::decodeLoop(const QString& path) {
+    // Format-level check only; imageCount() would scan the whole GIF. Done here
+    // rather than in start() so showing an image never waits on this read.
+    bool animated;
+    {
+        QImageReader probe(path);
+        animated = probe.canRead() && probe.supportsAnimation();
+    }
+    QSharedPointer<MappedFile> file = animated ? MappedFile::open(path) : QSharedPointer<MappedFile>();
+    if (!file) {
+        QMutexLocker locker(&m_mutex);
+        m_decoderFinished = true;
+        return;
+    }
+
+    int playsLeft = -1; // Unknown until the first reader reports its loop count
+    int framesPerLoop = 0;
+    while (!m_stopRequested.loadAcquire()) {
+        // A fresh reader per loop: GIF handlers can only move forward
+        MappedFileDevice device(file);
+        device.setCancelCheck([this]() { return m_stopRequested.loadAcquire() != 0; });
+        QImageReader reader(&device);
+        if (playsLeft < 0) {
+            const int loops = reader.loopCount(); // -1 means forever, n means n repeats after the first play
+            playsLeft = (loops < 0) ? 0 : loops + 1;
+        }
+
+        int frameCount = 0;
+        Frame firstFrame;
+        while (reader.canRead() && !m_stopRequested.loadAcquire()) {
+            QImage image = reader.read();
+            if (image.isNull()) break;
+            // Convert here so the GUI thread paints the frame without another conversion
+            image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            int delay = reader.nextImageDelay();
+            delay = (delay < kMinFrameDelayMs) ? kDefaultFrameDelayMs : delay;
+            ++frameCount;
+
+            if (framesPerLoop == 0 && frameCount == 1) {
+                firstFrame = {image, delay}; // Held back until a second frame proves it is animated
+                continue;
+            }
+
+            QMutexLocker locker(&m_mutex);
+            while (m_frames.size() >= kBufferedFrames && !m_stopRequested.loadAcquire()) {
+                m_notFull.wait(&m_mutex);
+            }
+            if (m_stopRequested.loadAcquire()) break;
+            if (!firstFrame.image.isNull()) {
+                m_frames.enqueue(firstFrame);
+                firstFrame = Frame();
+            }
+            m_frames.enqueue({image, delay});
+        }
+
+        if (framesPerLoop == 0) framesPerLoop = frameCount;
+        if (framesPerLoop < 2 || frameCount == 0) break; // Still image or a decode error
+        if (playsLeft > 0 && --playsLeft == 0) break;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_decoderFinished = true;
+}
+
+void AnimationPlayer::showNextFrame() {
+    Frame frame;
+    bool finished = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_frames.isEmpty()) {
+            finished = m_decoderFinished;
+        } else {
+            frame = m_frames.dequeue();
+            m_notFull.wakeOne();
+        }
+    }
+
+    if (frame.image.isNull()) {
+        if (finished) {
+            stop(); // Played out, or a single frame that is already on screen
+        } else {
+            m_frameTimer.start(kUnderrunRetryMs); // Decoder is behind; playback waits, the GUI doesn't
+        }
+        return;
+    }
+    emit frameReady(frame.image);
+    m_frameTimer.start(frame.delayMs);
+}
@@ -0,0 +1,56 @@
+#ifndef ANIMATIONPLAYER_H
+#define ANIMATIONPLAYER_H
+
+#include <QObject>
+#include <QImage>
+#include <QString>
+#include <QTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QThread>
+#include <QQueue>
+
+// Plays animated images (GIF, animated WebP, ...) by decoding frames on a
+// dedicated thread just ahead of the playback clock. Only a few composited
+// frames are buffered, so memory stays flat no matter how many frames the file
+// has, and the GUI thread only pops ready frames off the buffer.
+class AnimationPlayer : public QObject {
+    Q_OBJECT
+public:
+    explicit AnimationPlayer(QObject* parent = nullptr);
+    ~AnimationPlayer();
+
+    // Starts playing path. The format is probed on the decoder thread, so this
+    // never touches the file; still images and files that turn out to have a
+    // single frame stop on their own without emitting anything.
+    void start(const QString& path);
+    void stop();
+    bool isPlaying() const { return m_decoder != nullptr; }
+
+signals:
+    void frameReady(const QImage& frame);
+
+private slots:
+    void showNextFrame();
+
+private:
+    struct Frame {
+        QImage image;
+        int delayMs = 0;
+    };
+
+    void decodeLoop(const QString& path);
+
+    QThread* m_decoder;
+    QTimer m_frameTimer;
+
+    // Ring buffer shared with the decoder thread
+    QMutex m_mutex;
+    QWaitCondition m_notFull;
+    QQueue<Frame> m_frames;
+    bool m_decoderFinished;
+    QAtomicInt m_stopRequested;
+};
+
+#endif // ANIMATIONPLAYER_H
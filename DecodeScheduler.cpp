@@ -0,0 +1,214 @@
+#include "DecodeScheduler.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <QtConcurrent> // Stages run on m_pools
+
+namespace {
+// Files are faulted in chunk by chunk, so a job superseded meanwhile stops reading
+const qint64 kPrefaultChunkBytes = 8LL * 1024 * 1024;
+const qint64 kPageSize = 4096;
+// Prefetches are a guess; they may take one thread per stage, the rest stays for
+// the visible image and the thumbnails the user is looking at
+const int kMaxRunningPrefetches = 1;
+}
+
+DecodeScheduler* DecodeScheduler::instance() {
+    static DecodeScheduler scheduler;
+    return &scheduler;
+}
+
+DecodeScheduler::DecodeScheduler() : m_nextId(0) {
+    m_running[IoStage] = m_running[CpuStage] = 0;
+    m_runningPrefetches[IoStage] = m_runningPrefetches[CpuStage] = 0;
+    m_caps[IoStage] = 2; // More parallel reads mostly add seeks on spinning disks
+    m_caps[CpuStage] = qMax(2, QThread::idealThreadCount());
+    for (int stage = 0; stage < StageCount; ++stage) {
+        m_pools[stage].setMaxThreadCount(m_caps[stage]);
+    }
+}
+
+DecodeScheduler::~DecodeScheduler() {
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queued.clear();
+        for (auto& stageQueues : m_queues) {
+            for (std::list<JobId>& queue : stageQueues) queue.clear();
+        }
+    }
+    for (QThreadPool& pool : m_pools) {
+        pool.waitForDone();
+    }
+}
+
+DecodeScheduler::JobId DecodeScheduler::schedule(const Job& job) {
+    QMutexLocker locker(&m_mutex);
+    const JobId id = ++m_nextId;
+    Entry entry;
+    entry.job = job;
+    entry.stage = job.path.isEmpty() ? CpuStage : IoStage;
+    enqueueLocked(id, m_queued.insert(id, entry).value());
+    dispatchLocked();
+    return id;
+}
+
+bool DecodeScheduler::reprioritize(JobId id, Priority priority) {
+    QMutexLocker locker(&m_mutex);
+    auto it = m_queued.find(id);
+    if (it == m_queued.end()) return false;
+    if (it->job.priority != priority) {
+        m_queues[it->stage][it->job.priority].erase(it->position);
+        it->job.priority = priority;
+        enqueueLocked(id, it.value());
+        dispatchLocked(); // A promoted job may fit the reserved slot
+    }
+    return true;
+}
+
+bool DecodeScheduler::cancel(JobId id) {
+    std::function<void()> dropped;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_queued.find(id);
+        if (it == m_queued.end()) return false;
+        m_queues[it->stage][it->job.priority].erase(it->position);
+        dropped = it->job.dropped;
+        if (it->ownerCounted) releaseOwnerLocked(it->job.owner);
+        m_queued.erase(it);
+    }
+    if (dropped) dropped(); // Outside the lock, it may schedule again
+    return true;
+}
+
+void DecodeScheduler::cancelOwner(const void* owner) {
+    QList<std::function<void()>> droppedCallbacks;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_queued.begin(); it != m_queued.end();) {
+            if (it->job.owner != owner) {
+                ++it;
+                continue;
+            }
+            m_queues[it->stage][it->job.priority].erase(it->position);
+            if (it->job.dropped) droppedCallbacks << it->job.dropped;
+            if (it->ownerCounted) releaseOwnerLocked(owner);
+            it = m_queued.erase(it);
+        }
+    }
+    for (const auto& dropped : droppedCallbacks) {
+        dropped();
+    }
+}
+
+void DecodeScheduler::waitForOwner(const void* owner) {
+    QMutexLocker locker(&m_mutex);
+    while (m_runningByOwner.value(owner) > 0) {
+        m_ownerIdle.wait(&m_mutex);
+    }
+}
+
+void DecodeScheduler::setIoConcurrency(int threads) {
+    QMutexLocker locker(&m_mutex);
+    m_caps[IoStage] = qMax(1, threads);
+    m_pools[IoStage].setMaxThreadCount(m_caps[IoStage]);
+    dispatchLocked();
+}
+
+void DecodeScheduler::setCpuConcurrency(int threads) {
+    QMutexLocker locker(&m_mutex);
+    m_caps[CpuStage] = qMax(1, threads);
+    m_pools[CpuStage].setMaxThreadCount(m_caps[CpuStage]);
+    dispatchLocked();
+}
+
+void DecodeScheduler::enqueueLocked(JobId id, Entry& entry) {
+    std::list<JobId>& queue = m_queues[entry.stage][entry.job.priority];
+    entry.position = queue.insert(queue.end(), id);
+}
+
+void DecodeScheduler::dispatchLocked() {
+    for (int stage = 0; stage < StageCount; ++stage) {
+        while (m_running[stage] < m_caps[stage]) {
+            // The last CPU slot only takes work for the visible image, so it can start
+            // right away even while every other thread is busy with thumbnails
+            const bool reservedSlot = (stage == CpuStage && m_caps[stage] > 1 && m_running[stage] == m_caps[stage] - 1);
+            if (!startNextLocked(Stage(stage), reservedSlot)) break;
+        }
+    }
+}
+
+bool DecodeScheduler::startNextLocked(Stage stage, bool visibleOnly) {
+    const int lastPriority = visibleOnly ? VisibleImage : PriorityCount - 1;
+    for (int priority = 0; priority <= lastPriority; ++priority) {
+        std::list<JobId>& queue = m_queues[stage][priority];
+        if (queue.empty()) continue;
+        if (priority == NeighborPrefetch && m_runningPrefetches[stage] >= kMaxRunningPrefetches) continue;
+        const JobId id = queue.front();
+        queue.pop_front();
+        const Entry entry = m_queued.take(id);
+        ++m_running[stage];
+        if (priority == NeighborPrefetch) ++m_runningPrefetches[stage];
+        if (!entry.ownerCounted) ++m_runningByOwner[entry.job.owner];
+        QtConcurrent::run(&m_pools[stage], [this, id, entry]() { execute(id, entry); });
+        return true;
+    }
+    return false;
+}
+
+void DecodeScheduler::execute(JobId id, Entry entry) {
+    if (entry.job.isStale && entry.job.isStale()) {
+        if (entry.job.dropped) entry.job.dropped();
+        finish(entry.job, entry.stage);
+        return;
+    }
+
+    if (entry.stage == IoStage) {
+        entry.file = MappedFile::open(entry.job.path);
+        if (entry.file) prefault(*entry.file, entry.job.isStale);
+        // On to the CPU queue at the same priority; it can still be reprioritised or cancelled there.
+        // The owner stays counted while it waits, or waitForOwner() would return between the
+        // two stages and the CPU stage would run against a destroyed owner.
+        QMutexLocker locker(&m_mutex);
+        entry.stage = CpuStage;
+        entry.ownerCounted = true;
+        ++m_runningByOwner[entry.job.owner];
+        enqueueLocked(id, m_queued.insert(id, entry).value());
+        locker.unlock();
+        finish(entry.job, IoStage);
+        return;
+    }
+
+    entry.job.run(entry.file);
+    finish(entry.job, CpuStage);
+}
+
+void DecodeScheduler::finish(const Job& job, Stage stage) {
+    QMutexLocker locker(&m_mutex);
+    --m_running[stage];
+    if (job.priority == NeighborPrefetch) --m_runningPrefetches[stage];
+    releaseOwnerLocked(job.owner);
+    dispatchLocked();
+}
+
+void DecodeScheduler::releaseOwnerLocked(const void* owner) {
+    auto it = m_runningByOwner.find(owner);
+    if (it != m_runningByOwner.end() && --it.value() <= 0) {
+        m_runningByOwner.erase(it);
+        m_ownerIdle.wakeAll();
+    }
+}
+
+void DecodeScheduler::prefault(const MappedFile& file, const std::function<bool()>& isStale) {
+    if (!file.isMapped()) return; // A fallback copy is already in memory
+    // Touch one byte per page so the disk reads happen here, under the I/O cap,
+    // and the decoder then runs from the page cache
+    volatile uchar sink = 0;
+    const uchar* data = file.data();
+    for (qint64 chunk = 0; chunk < file.size(); chunk += kPrefaultChunkBytes) {
+        if (chunk > 0 && isStale && isStale()) break; // The CPU stage drops it as well
+        const qint64 end = qMin(file.size(), chunk + kPrefaultChunkBytes);
+        for (qint64 offset = chunk; offset < end; offset += kPageSize) {
+            sink = sink + data[offset];
+        }
+    }
+    Q_UNUSED(sink);
+}
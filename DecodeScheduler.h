@@ -0,0 +1,95 @@
+#ifndef DECODESCHEDULER_H
+#define DECODESCHEDULER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+#include <functional>
+#include <list>
+#include "MappedFile.h"
+
+// Single queue for all background image work (viewer decodes, prefetch, tiles,
+// thumbnails), so a folder of thousands of thumbnails can't bury the image the
+// user is looking at. Jobs are started strictly by priority class. A job with
+// a path first runs an I/O stage that maps the file and faults it into the page
+// cache, then a CPU stage that decodes it; the two stages have separate
+// concurrency caps so disk reads and decodes don't starve each other. One CPU
+// slot is kept for VisibleImage jobs, and NeighborPrefetch jobs run one at a
+// time per stage.
+//
+// Queued jobs can be reprioritised or cancelled; a job that already started
+// runs to completion (decoders have their own cancel checks for that).
+class DecodeScheduler {
+public:
+    enum Priority {
+        VisibleImage,       // The image on screen and its tiles
+        NeighborPrefetch,
+        VisibleThumbnail,
+        OffscreenThumbnail,
+        PriorityCount
+    };
+
+    using JobId = quint64;
+
+    struct Job {
+        Priority priority = OffscreenThumbnail;
+        QString path;        // File for the I/O stage; empty to go straight to the CPU stage
+        const void* owner = nullptr; // For cancelOwner()/waitForOwner(), usually the submitting object
+        // CPU stage. file is the mapping from the I/O stage (null without path or when
+        // mapping failed); keeping it alive means later MappedFile::open() calls reuse it.
+        std::function<void(const QSharedPointer<MappedFile>& file)> run;
+        // Optional: checked before each stage, a stale job is dropped like a cancelled one
+        std::function<bool()> isStale;
+        // Optional: called instead of run when the job is dropped. May be called on any thread.
+        std::function<void()> dropped;
+    };
+
+    static DecodeScheduler* instance();
+    ~DecodeScheduler();
+
+    JobId schedule(const Job& job);
+    bool reprioritize(JobId id, Priority priority); // False once the job has started
+    bool cancel(JobId id);                          // False once the job has started
+    void cancelOwner(const void* owner);            // Drops all queued jobs of owner
+    void waitForOwner(const void* owner);           // Blocks until owner's started jobs finished all stages
+
+    void setIoConcurrency(int threads);
+    void setCpuConcurrency(int threads);
+
+private:
+    DecodeScheduler();
+
+    enum Stage { IoStage, CpuStage, StageCount };
+
+    struct Entry {
+        Job job;
+        Stage stage;
+        QSharedPointer<MappedFile> file;
+        std::list<JobId>::iterator position;
+        bool ownerCounted = false; // Queued for the CPU stage, still counted in m_runningByOwner
+    };
+
+    void enqueueLocked(JobId id, Entry& entry);
+    void dispatchLocked();
+    bool startNextLocked(Stage stage, bool visibleOnly);
+    void execute(JobId id, Entry entry);
+    void finish(const Job& job, Stage stage);
+    void releaseOwnerLocked(const void* owner);
+    static void prefault(const MappedFile& file, const std::function<bool()>& isStale);
+
+    QMutex m_mutex;
+    QWaitCondition m_ownerIdle;
+    QHash<JobId, Entry> m_queued;
+    std::list<JobId> m_queues[StageCount][PriorityCount];
+    int m_running[StageCount];
+    int m_caps[StageCount];
+    int m_runningPrefetches[StageCount]; // NeighborPrefetch jobs among m_running
+    QHash<const void*, int> m_runningByOwner;
+    JobId m_nextId;
+    QThreadPool m_pools[StageCount];
+};
+
+#endif // DECODESCHEDULER_H
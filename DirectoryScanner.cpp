@@ -0,0 +1,86 @@
+#include "DirectoryScanner.h"
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QMetaObject>
+#include <QThread>
+
+namespace {
+// Later entries are batched so a 50k-entry directory costs tens of GUI events, not thousands
+const int kChunkEntries = 512;
+const int kChunkIntervalMs = 50;
+}
+
+DirectoryScanner::DirectoryScanner(QObject* parent) : QObject(parent), m_currentScan(0) {}
+
+DirectoryScanner::~DirectoryScanner() {
+    cancel();
+    for (QThread* thread : m_threads) {
+        thread->wait(); // Returns after the current readdir() at the latest
+        delete thread;
+    }
+}
+
+QStringList DirectoryScanner::nameFilters() {
+    return QStringList() << "*.png" << "*.jpg" << "*.jpeg" << "*.bmp" << "*.gif" << "*.tiff" << "*.tif"; // Common image formats
+}
+
+quint64 DirectoryScanner::scan(const QString& directory) {
+    cancel();
+    const quint64 scanId = ++m_currentScan;
+    QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    m_cancelled = cancelled;
+
+    // One thread per scan: a previous scan stuck on a slow mount must not delay this one
+    QThread* thread = QThread::create([this, scanId, directory, cancelled]() { scanLoop(scanId, directory, cancelled); });
+    m_threads.append(thread);
+    connect(thread, &QThread::finished, this, [this, thread]() {
+        m_threads.removeOne(thread);
+        thread->deleteLater();
+    });
+    thread->start(QThread::LowPriority);
+    return scanId;
+}
+
+void DirectoryScanner::cancel() {
+    if (m_cancelled) {
+        m_cancelled->storeRelease(1);
+        m_cancelled.reset();
+    }
+    ++m_currentScan; // Chunks already queued for the GUI thread are dropped on arrival
+}
+
+void DirectoryScanner::scanLoop(quint64 scanId, const QString& directory, const QSharedPointer<QAtomicInt>& cancelled) {
+    // QDirIterator reads entries lazily and takes the file type from readdir()'s
+    // d_type where the file system provides it, so no stat() per entry
+    QDirIterator it(directory, nameFilters(), QDir::Files | QDir::NoDotAndDotDot);
+    QStringList chunk;
+    QElapsedTimer sinceFlush;
+    sinceFlush.start();
+    int count = 0;
+    bool firstSent = false;
+
+    auto flush = [&]() {
+        if (chunk.isEmpty()) return;
+        const QStringList fileNames = chunk;
+        chunk.clear();
+        QMetaObject::invokeMethod(this, [this, scanId, fileNames]() {
+            if (scanId == m_currentScan) emit entriesFound(scanId, fileNames);
+        }, Qt::QueuedConnection);
+        sinceFlush.restart();
+    };
+
+    while (it.hasNext() && !cancelled->loadAcquire()) {
+        it.next();
+        chunk << it.fileName();
+        ++count;
+        if (!firstSent || chunk.size() >= kChunkEntries || sinceFlush.elapsed() >= kChunkIntervalMs) {
+            flush(); // The first image goes out alone, so it can be opened right away
+            firstSent = true;
+        }
+    }
+    if (cancelled->loadAcquire()) return;
+    flush();
+    QMetaObject::invokeMethod(this, [this, scanId, count]() {
+        if (scanId == m_currentScan) emit scanFinished(scanId, count);
+    }, Qt::QueuedConnection);
+}
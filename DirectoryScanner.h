@@ -0,0 +1,43 @@
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QList>
+
+class QThread;
+
+// Lists the images of a directory incrementally on a background thread. Entries
+// arrive in directory order through entriesFound(), the first one on its own so
+// the caller can open it before the rest of a large (or network) directory has
+// been read; after that in chunks. This is the one listing shared by the gallery
+// and the application's navigation list.
+class DirectoryScanner : public QObject {
+    Q_OBJECT
+public:
+    explicit DirectoryScanner(QObject* parent = nullptr);
+    ~DirectoryScanner();
+
+    static QStringList nameFilters(); // The image extensions listed
+
+    // Starts listing directory and returns the scan id carried by the signals.
+    // A new scan cancels the previous one; its late chunks are not delivered.
+    quint64 scan(const QString& directory);
+    void cancel();
+
+signals:
+    void entriesFound(quint64 scanId, const QStringList& fileNames); // Names relative to the directory
+    void scanFinished(quint64 scanId, int count);
+
+private:
+    void scanLoop(quint64 scanId, const QString& directory, const QSharedPointer<QAtomicInt>& cancelled);
+
+    quint64 m_currentScan;
+    QSharedPointer<QAtomicInt> m_cancelled; // Of the current scan
+    QList<QThread*> m_threads;             // Running scans, cancelled ones included
+};
+
+#endif // DIRECTORYSCANNER_H
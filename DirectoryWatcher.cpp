@@ -0,0 +1,144 @@
+#include "DirectoryWatcher.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#ifdef Q_OS_LINUX
+#include <QSocketNotifier>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#else
+#include <QFileSystemWatcher>
+#endif
+
+namespace {
+// Quiet period that ends a burst, and the longest a change waits while a burst goes on
+const int kCoalesceMs = 250;
+
+#ifndef Q_OS_LINUX
+// QSet::fromList() is deprecated since Qt 5.14 and the range constructor is new in it
+QSet<QString> listFiles(const QString& directory) {
+    QSet<QString> files;
+    for (const QString& fileName : QDir(directory).entryList(QDir::Files | QDir::NoDotAndDotDot)) {
+        files.insert(fileName);
+    }
+    return files;
+}
+#endif
+}
+
+DirectoryWatcher::DirectoryWatcher(QObject* parent)
+    : QObject(parent),
+#ifdef Q_OS_LINUX
+      m_inotifyFd(-1), m_watchDescriptor(-1), m_notifier(nullptr)
+#else
+      m_watcher(nullptr)
+#endif
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kCoalesceMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &DirectoryWatcher::flush);
+#ifdef Q_OS_LINUX
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        qWarning() << "inotify unavailable, the gallery will not follow directory changes";
+        return;
+    }
+    m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &DirectoryWatcher::readInotifyEvents);
+#else
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &DirectoryWatcher::diffListing);
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher() {
+    stop();
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd >= 0) {
+        delete m_notifier;
+        ::close(m_inotifyFd);
+    }
+#endif
+}
+
+void DirectoryWatcher::watch(const QString& directory) {
+    stop();
+    m_directory = directory;
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd < 0) return;
+    // IN_CLOSE_WRITE rather than IN_CREATE: a file still being written is not worth thumbnailing
+    m_watchDescriptor = inotify_add_watch(m_inotifyFd, QFile::encodeName(directory).constData(),
+                                          IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE | IN_ONLYDIR);
+    if (m_watchDescriptor < 0) {
+        qWarning() << "Cannot watch directory:" << directory << strerror(errno);
+    }
+#else
+    m_listing = listFiles(directory);
+    m_watcher->addPath(directory);
+#endif
+}
+
+void DirectoryWatcher::stop() {
+#ifdef Q_OS_LINUX
+    if (m_watchDescriptor >= 0) {
+        inotify_rm_watch(m_inotifyFd, m_watchDescriptor);
+        m_watchDescriptor = -1;
+    }
+#else
+    if (!m_watcher->directories().isEmpty()) {
+        m_watcher->removePaths(m_watcher->directories());
+    }
+    m_listing.clear();
+#endif
+    m_pending.clear();
+    m_flushTimer.stop();
+    m_directory.clear();
+}
+
+void DirectoryWatcher::noteChanged(const QString& fileName) {
+    m_pending.insert(fileName);
+    // Not restarted by later events, so a continuous stream still flushes every kCoalesceMs
+    if (!m_flushTimer.isActive()) m_flushTimer.start();
+}
+
+void DirectoryWatcher::flush() {
+    if (m_pending.isEmpty()) return;
+    const QStringList fileNames = m_pending.values();
+    m_pending.clear();
+    emit entriesChanged(fileNames);
+}
+
+#ifdef Q_OS_LINUX
+void DirectoryWatcher::readInotifyEvents() {
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        const ssize_t length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) break; // EAGAIN: drained
+        for (char* cursor = buffer; cursor < buffer + length;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(cursor);
+            cursor += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                m_pending.clear();
+                emit rescanNeeded();
+                continue;
+            }
+            // Events queued before a stop() or for a previous directory carry a stale descriptor
+            if (event->wd != m_watchDescriptor || event->len == 0 || (event->mask & IN_ISDIR)) continue;
+            noteChanged(QFile::decodeName(event->name));
+        }
+    }
+}
+#else
+void DirectoryWatcher::diffListing() {
+    const QSet<QString> listing = listFiles(m_directory);
+    for (const QString& fileName : listing) {
+        if (!m_listing.contains(fileName)) noteChanged(fileName);
+    }
+    for (const QString& fileName : m_listing) {
+        if (!listing.contains(fileName)) noteChanged(fileName);
+    }
+    m_listing = listing;
+}
+#endif
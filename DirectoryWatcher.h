@@ -0,0 +1,58 @@
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+class QSocketNotifier;
+class QFileSystemWatcher;
+
+// Watches one directory and reports which entries changed, so the gallery can
+// be updated in place instead of relisting everything. Events are coalesced:
+// a burst (a camera dumping a card, a scanner writing pages) is reported as one
+// entriesChanged() with each touched name once. The receiver compares the names
+// against what it shows to tell additions, removals and modifications apart;
+// a rename is simply its old and its new name.
+//
+// On Linux this is inotify on the directory. Files are reported on IN_CLOSE_WRITE,
+// i.e. once they are completely written, and on moves and deletes. Elsewhere
+// QFileSystemWatcher is diffed against the previous listing, which catches
+// additions, removals and renames but not in-place modifications.
+class DirectoryWatcher : public QObject {
+    Q_OBJECT
+public:
+    explicit DirectoryWatcher(QObject* parent = nullptr);
+    ~DirectoryWatcher();
+
+    void watch(const QString& directory); // Replaces the previous directory
+    void stop();
+    QString directory() const { return m_directory; }
+
+signals:
+    void entriesChanged(const QStringList& fileNames); // Names relative to directory()
+    void rescanNeeded(); // Events were lost (queue overflow); only a full listing is reliable
+
+private slots:
+    void flush();
+
+private:
+    void noteChanged(const QString& fileName);
+#ifdef Q_OS_LINUX
+    void readInotifyEvents();
+    int m_inotifyFd;
+    int m_watchDescriptor;
+    QSocketNotifier* m_notifier;
+#else
+    void diffListing();
+    QFileSystemWatcher* m_watcher;
+    QSet<QString> m_listing;
+#endif
+    QString m_directory;
+    QSet<QString> m_pending;
+    QTimer m_flushTimer;
+};
+
+#endif // DIRECTORYWATCHER_H
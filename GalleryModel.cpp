@@ -0,0 +1,214 @@
+#include "GalleryModel.h"
+#include <QDir>
+#include <QLocale>
+#include <algorithm>
+#include <functional>
+
+GalleryModel::GalleryModel(QObject* parent) : QAbstractListModel(parent) {}
+
+void GalleryModel::setFileNames(const QStringList& fileNames) {
+    beginResetModel();
+    m_entries.clear();
+    m_entries.reserve(fileNames.size());
+    for (const QString& fileName : fileNames) {
+        Entry entry;
+        entry.fileName = fileName;
+        m_entries.append(entry);
+    }
+    m_atlas.reset(m_atlas.slotSize());
+    rebuildIndex();
+    endResetModel();
+}
+
+void GalleryModel::clear() {
+    setFileNames(QStringList());
+}
+
+void GalleryModel::appendFileNames(const QStringList& fileNames) {
+    if (fileNames.isEmpty()) return;
+    const int first = m_entries.size();
+    beginInsertRows(QModelIndex(), first, first + fileNames.size() - 1);
+    m_entries.reserve(first + fileNames.size());
+    for (const QString& fileName : fileNames) {
+        Entry entry;
+        entry.fileName = fileName;
+        m_rows.insert(fileName, m_entries.size());
+        m_entries.append(entry);
+    }
+    endInsertRows();
+}
+
+void GalleryModel::removeFileNames(const QStringList& fileNames) {
+    QVector<int> rows;
+    for (const QString& fileName : fileNames) {
+        const int row = rowForName(fileName);
+        if (row >= 0) rows.append(row);
+    }
+    if (rows.isEmpty()) return;
+    // Back to front, so the rows still to be removed keep their numbers; adjacent
+    // rows (a deleted burst of one camera's files) go in a single removal
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end()); // Same name listed twice
+    for (int i = 0; i < rows.size();) {
+        const int last = rows.at(i);
+        int first = last;
+        while (++i < rows.size() && rows.at(i) == first - 1) first = rows.at(i);
+        beginRemoveRows(QModelIndex(), first, last);
+        for (int row = first; row <= last; ++row) m_atlas.remove(m_entries.at(row).thumbnailSlot);
+        m_entries.remove(first, last - first + 1);
+        endRemoveRows();
+    }
+    rebuildIndex();
+}
+
+void GalleryModel::setOrder(const QStringList& fileNames) {
+    emit layoutAboutToBeChanged();
+    const QModelIndexList oldIndexes = persistentIndexList();
+    QVector<Entry> reordered;
+    reordered.reserve(m_entries.size());
+    QVector<bool> taken(m_entries.size(), false);
+    for (const QString& fileName : fileNames) {
+        const int row = rowForName(fileName);
+        if (row < 0 || taken.at(row)) continue;
+        taken[row] = true;
+        reordered.append(m_entries.at(row));
+    }
+    for (int row = 0; row < m_entries.size(); ++row) {
+        if (!taken.at(row)) reordered.append(m_entries.at(row)); // Not in the ordering, keep them at the end
+    }
+    m_entries.swap(reordered);
+    rebuildIndex();
+
+    QModelIndexList newIndexes;
+    for (const QModelIndex& oldIndex : oldIndexes) {
+        // reordered now holds the previous order
+        newIndexes << index(rowForName(reordered.at(oldIndex.row()).fileName));
+    }
+    changePersistentIndexList(oldIndexes, newIndexes);
+    emit layoutChanged();
+}
+
+void GalleryModel::setHeaders(const QString& directory, const QHash<QString, ImageHeaderInfo>& headers) {
+    const QDir dir(directory);
+    for (Entry& entry : m_entries) {
+        auto it = headers.constFind(dir.filePath(entry.fileName));
+        if (it == headers.constEnd() || !it->isValid()) continue;
+        entry.imageSize = it->size;
+        entry.captureTime = it->captureTime;
+        entry.cameraModel = it->cameraModel;
+    }
+    if (!m_entries.isEmpty()) {
+        emit dataChanged(index(0), index(m_entries.size() - 1), {Qt::ToolTipRole, CaptureTimeRole, PixelCountRole});
+    }
+}
+
+void GalleryModel::setThumbnail(int row, const QImage& thumbnail) {
+    setThumbnails({qMakePair(row, thumbnail)});
+}
+
+void GalleryModel::setThumbnails(const QVector<QPair<int, QImage>>& thumbnails) {
+    if (thumbnails.isEmpty()) return;
+    int first = thumbnails.first().first;
+    int last = first;
+    for (const QPair<int, QImage>& thumbnail : thumbnails) {
+        Entry& entry = m_entries[thumbnail.first];
+        m_atlas.remove(entry.thumbnailSlot);
+        entry.thumbnailSlot = m_atlas.insert(thumbnail.second);
+        entry.failed = false;
+        first = qMin(first, thumbnail.first);
+        last = qMax(last, thumbnail.first);
+    }
+    emit dataChanged(index(first), index(last), {Qt::DecorationRole, HasThumbnailRole});
+}
+
+void GalleryModel::setThumbnailFailed(int row) {
+    m_entries[row].failed = true;
+}
+
+void GalleryModel::releaseThumbnail(int row) {
+    Entry& entry = m_entries[row];
+    if (entry.thumbnailSlot < 0) return;
+    m_atlas.remove(entry.thumbnailSlot);
+    entry.thumbnailSlot = -1;
+    const QModelIndex changed = index(row);
+    emit dataChanged(changed, changed, {Qt::DecorationRole, HasThumbnailRole});
+}
+
+void GalleryModel::resetThumbnail(int row) {
+    releaseThumbnail(row);
+    m_entries[row].failed = false;
+}
+
+qint64 GalleryModel::compactThumbnails() {
+    QHash<int, int> rowsBySlot;
+    rowsBySlot.reserve(m_atlas.usedSlots());
+    for (int row = 0; row < m_entries.size(); ++row) {
+        if (m_entries.at(row).thumbnailSlot >= 0) rowsBySlot.insert(m_entries.at(row).thumbnailSlot, row);
+    }
+    // Pixels are copied unchanged, so views need no repaint
+    return m_atlas.compact([this, &rowsBySlot](int from, int to) {
+        m_entries[rowsBySlot.value(from)].thumbnailSlot = to;
+    });
+}
+
+void GalleryModel::clearThumbnails() {
+    for (Entry& entry : m_entries) {
+        entry.thumbnailSlot = -1;
+        entry.failed = false;
+    }
+    m_atlas.reset(m_atlas.slotSize());
+    if (!m_entries.isEmpty()) {
+        emit dataChanged(index(0), index(m_entries.size() - 1), {Qt::DecorationRole, HasThumbnailRole});
+    }
+}
+
+void GalleryModel::setThumbnailSize(const QSize& size) {
+    if (size == m_atlas.slotSize()) return;
+    clearThumbnails();
+    m_atlas.reset(size);
+}
+
+int GalleryModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : m_entries.size();
+}
+
+QVariant GalleryModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= m_entries.size()) return QVariant();
+    const Entry& entry = m_entries.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return entry.fileName;
+    case Qt::DecorationRole:
+        return m_atlas.image(entry.thumbnailSlot); // A copy; the delegate paints from the atlas instead
+    case Qt::ToolTipRole: {
+        // Built on demand rather than stored per row
+        QString toolTip = entry.fileName;
+        if (entry.imageSize.isValid()) {
+            toolTip += "\n" + QString::number(entry.imageSize.width()) + " x " + QString::number(entry.imageSize.height());
+        }
+        if (entry.captureTime.isValid()) {
+            toolTip += "\n" + QLocale::system().toString(entry.captureTime, QLocale::ShortFormat);
+        }
+        if (!entry.cameraModel.isEmpty()) {
+            toolTip += "\n" + entry.cameraModel;
+        }
+        return toolTip;
+    }
+    case CaptureTimeRole:
+        return entry.captureTime;
+    case PixelCountRole:
+        return qint64(entry.imageSize.width()) * entry.imageSize.height();
+    case HasThumbnailRole:
+        return entry.thumbnailSlot >= 0;
+    default:
+        return QVariant();
+    }
+}
+
+void GalleryModel::rebuildIndex() {
+    m_rows.clear();
+    m_rows.reserve(m_entries.size());
+    for (int row = 0; row < m_entries.size(); ++row) {
+        m_rows.insert(m_entries.at(row).fileName, row);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef GALLERYMODEL_H
+#define GALLERYMODEL_H
+
+#include <QAbstractListModel>
+#include <QDateTime>
+#include <QHash>
+#include <QPair>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "ImageHeaderParser.h"
+#include "ThumbnailAtlas.h"
+
+// Flat list model behind ImageGalleryWidget. Each row is one compact Entry
+// (no per-row QObject, QIcon or item allocation); thumbnails live in a shared
+// ThumbnailAtlas and a row only stores its slot id. Names map to rows through a
+// hash, so lookups by file name are O(1) even for 100k-entry directories.
+class GalleryModel : public QAbstractListModel {
+    Q_OBJECT
+public:
+    enum Role {
+        CaptureTimeRole = Qt::UserRole + 1,
+        PixelCountRole,
+        HasThumbnailRole
+    };
+
+    explicit GalleryModel(QObject* parent = nullptr);
+
+    void setFileNames(const QStringList& fileNames); // Resets the model
+    void clear();
+    void appendFileNames(const QStringList& fileNames); // Streamed directory listings
+    void removeFileNames(const QStringList& fileNames); // Names not in the model are ignored
+    void setOrder(const QStringList& fileNames);     // Keeps selection and other persistent indexes
+    void setHeaders(const QString& directory, const QHash<QString, ImageHeaderInfo>& headers);
+
+    int rowForName(const QString& fileName) const { return m_rows.value(fileName, -1); }
+    QString fileName(int row) const { return m_entries.at(row).fileName; }
+
+    bool hasThumbnail(int row) const { return m_entries.at(row).thumbnailSlot >= 0; }
+    bool thumbnailFailed(int row) const { return m_entries.at(row).failed; }
+    int thumbnailSlot(int row) const { return m_entries.at(row).thumbnailSlot; }
+    const ThumbnailAtlas& thumbnails() const { return m_atlas; } // For painting
+    void setThumbnail(int row, const QImage& thumbnail);
+    // A batch of (row, thumbnail) pairs with a single dataChanged() over their span,
+    // so the view repaints once instead of once per row
+    void setThumbnails(const QVector<QPair<int, QImage>>& thumbnails);
+    void setThumbnailFailed(int row);
+    void releaseThumbnail(int row);    // Frees the slot; memory comes back on compactThumbnails()
+    void resetThumbnail(int row);      // Also forgets a failure, so the file is thumbnailed again
+    qint64 compactThumbnails();        // Returns the bytes released
+    void clearThumbnails();            // Also drops the atlas pages
+    void setThumbnailSize(const QSize& size); // Slot size; clears all thumbnails
+    qint64 thumbnailBytes() const { return m_atlas.bytes(); }
+    qint64 thumbnailSlotBytes() const { return m_atlas.slotBytes(); }
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+private:
+    struct Entry {
+        QString fileName;
+        int thumbnailSlot = -1; // Slot in m_atlas, -1 until generated
+        QSize imageSize;        // From the header batch
+        QDateTime captureTime;
+        QString cameraModel;
+        bool failed = false;
+    };
+
+    void rebuildIndex();
+
+    QVector<Entry> m_entries;
+    QHash<QString, int> m_rows; // File name to row
+    ThumbnailAtlas m_atlas;
+};
+
+#endif // GALLERYMODEL_H
@@ -2,6 +2,7 @@
 #include "ImageViewerWidget.h"
 #include "ImageGalleryWidget.h"
 #include "ImageDataManager.h"
+#include "TiledImageSource.h"
 
 // Explicit includes
 #include <QMainWindow>
@@ -38,6 +39,17 @@
 #include <QDialog>
 #include <QPushButton>
 #include <QHBoxLayout>
+#include <QActionGroup>
+#include <algorithm> // For std::stable_sort
+#include <QDataStream>
+#include <QSet>
+#include <QHash>
+#include <QStatusBar>
+#include "ImageMemoryGovernor.h"
+#include "DecodeScheduler.h"
+#include "ThumbnailCache.h"
+#include "DirectoryScanner.h"
+#include "DirectoryWatcher.h"
 
 // --- NEW: Undo Command Implementations ---
 ImageOperationCommand::ImageOperationCommand(ImageViewerWidget* viewer, const ImageViewerState& oldState, const ImageViewerState& newState, const QString& text)
@@ -45,8 +57,10 @@ ImageOperationCommand::ImageOperationCommand(ImageViewerWidget* viewer, const Im
 
 void ImageOperationCommand::undo() {
     if (m_viewer) {
-        // Restore image data
-        m_viewer->setImageOnly(m_oldState.image); // Use new setImageOnly
+        // Restore image data (view-only commands carry none and keep the current pixels)
+        if (m_oldSpill || !m_oldState.image.isNull()) {
+            m_viewer->setImageOnly(m_oldSpill ? readSnapshot(m_oldSpill) : m_oldState.image);
+        }
         // Restore viewer transformations
         m_viewer->setZoomFactor(m_oldState.zoomFactor);
         m_viewer->setRotationAngle(m_oldState.rotationAngle); // Use new setRotationAngle
@@ -60,7 +74,9 @@ void ImageOperationCommand::undo() {
 void ImageOperationCommand::redo() {
     if (m_viewer) {
         // Apply image data
-        m_viewer->setImageOnly(m_newState.image); // Use new setImageOnly
+        if (m_newSpill || !m_newState.image.isNull()) {
+            m_viewer->setImageOnly(m_newSpill ? readSnapshot(m_newSpill) : m_newState.image);
+        }
         // Apply viewer transformations
         m_viewer->setZoomFactor(m_newState.zoomFactor);
         m_viewer->setRotationAngle(m_newState.rotationAngle);
@@ -71,6 +87,84 @@ void ImageOperationCommand::redo() {
     }
 }
 
+QList<QImage> ImageOperationCommand::residentSnapshots() const {
+    QList<QImage> images;
+    if (!m_oldState.image.isNull()) images << m_oldState.image;
+    if (!m_newState.image.isNull()) images << m_newState.image;
+    return images;
+}
+
+qint64 ImageOperationCommand::spillToDisk() {
+    // A snapshot shared with the neighbouring command or the viewer stays in memory until
+    // its last holder lets go, so only the last reference counts as released.
+    // The write happens on the GUI thread: the governor needs the memory back before it
+    // returns, and a raw sequential write into the page cache costs about as much as a copy.
+    qint64 released = 0;
+    if (!m_oldSpill && !m_oldState.image.isNull()) {
+        m_oldSpill = writeSnapshot(m_oldState.image);
+        if (m_oldSpill) {
+            if (m_oldState.image.isDetached()) released += m_oldState.image.sizeInBytes();
+            m_oldState.image = QImage();
+        }
+    }
+    if (!m_newSpill && !m_newState.image.isNull()) {
+        m_newSpill = writeSnapshot(m_newState.image);
+        if (m_newSpill) {
+            if (m_newState.image.isDetached()) released += m_newState.image.sizeInBytes();
+            m_newState.image = QImage();
+        }
+    }
+    return released;
+}
+
+QSharedPointer<QTemporaryFile> ImageOperationCommand::writeSnapshot(const QImage& image) {
+    // Raw scanlines rather than PNG: spilling happens under pressure and must be cheap
+    QSharedPointer<QTemporaryFile> file(new QTemporaryFile(QDir::tempPath() + "/imageview-undo-XXXXXX"));
+    if (!file->open()) {
+        qWarning() << "Could not create undo snapshot file:" << file->errorString();
+        return QSharedPointer<QTemporaryFile>();
+    }
+    QDataStream stream(file.data());
+    stream << qint32(image.format()) << qint32(image.width()) << qint32(image.height()) << image.colorTable();
+    const int lineBytes = image.width() * image.depth() / 8 + ((image.width() * image.depth()) % 8 ? 1 : 0);
+    for (int y = 0; y < image.height(); ++y) {
+        stream.writeRawData(reinterpret_cast<const char*>(image.constScanLine(y)), lineBytes);
+    }
+    if (stream.status() != QDataStream::Ok || !file->flush()) {
+        qWarning() << "Could not write undo snapshot:" << file->errorString();
+        return QSharedPointer<QTemporaryFile>();
+    }
+    file->close(); // Keeps the file (and its name), not a descriptor per snapshot
+    return file;
+}
+
+QImage ImageOperationCommand::readSnapshot(const QSharedPointer<QTemporaryFile>& file) {
+    if (!file->open()) {
+        qWarning() << "Could not reopen undo snapshot:" << file->fileName() << file->errorString();
+        return QImage();
+    }
+    QDataStream stream(file.data());
+    qint32 format = 0, width = 0, height = 0;
+    QVector<QRgb> colorTable;
+    stream >> format >> width >> height >> colorTable;
+    QImage image(width, height, QImage::Format(format));
+    if (image.isNull()) {
+        file->close();
+        return image;
+    }
+    image.setColorTable(colorTable);
+    const int lineBytes = image.width() * image.depth() / 8 + ((image.width() * image.depth()) % 8 ? 1 : 0);
+    for (int y = 0; y < image.height(); ++y) {
+        stream.readRawData(reinterpret_cast<char*>(image.scanLine(y)), lineBytes);
+    }
+    file->close();
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Undo snapshot is corrupt:" << file->fileName();
+        return QImage();
+    }
+    return image;
+}
+
 // Specific Undo Commands implementations
 ImageTransformCommand::ImageTransformCommand(ImageViewerWidget* viewer, const ImageViewerState& oldState, const ImageViewerState& newState, const QString& text)
     : ImageOperationCommand(viewer, oldState, newState, text) {}
@@ -87,6 +181,8 @@ ImageApplication::ImageApplication(int& argc, char** argv) : QApplication(argc,
     imageViewer = nullptr;
     imageGallery = nullptr;
     imageDataManager = nullptr;
+    directoryScanner = nullptr;
+    directoryWatcher = nullptr;
     undoStack = nullptr;
     settings = nullptr;
 
@@ -98,14 +194,24 @@ ImageApplication::ImageApplication(int& argc, char** argv) : QApplication(argc,
     rotateRightAct = nullptr; rotateLeftAct = nullptr; flipHorzAct = nullptr; flipVertAct = nullptr;
     grayscaleAct = nullptr; sepiaAct = nullptr; negativeAct = nullptr; normalAct = nullptr;
     metadataAct = nullptr; aboutAct = nullptr;
+    sortByNameAct = nullptr; sortByDateAct = nullptr; sortBySizeAct = nullptr;
+    thumbnailSmallAct = nullptr; thumbnailMediumAct = nullptr; thumbnailLargeAct = nullptr;
 
     currentImageIndex = -1;
+    pendingLoadRequest = 0;
+    fullResolutionRequest = 0;
+    headerBatchRequest = 0;
+    directoryScanRequest = 0;
+    undoMemoryConsumer = 0;
+    memoryStatusLabel = nullptr;
+    sortMode = ByName;
 
     QCoreApplication::setOrganizationName("DenebulaImaging");
     QCoreApplication::setApplicationName("ImageView");
 }
 
 ImageApplication::~ImageApplication() {
+    ImageMemoryGovernor::instance()->unregisterConsumer(undoMemoryConsumer);
     delete undoStack;
     // Parented objects (imageGallery, imageViewer, imageDataManager, settings, mainWindow) are automatically deleted.
 }
@@ -118,10 +224,28 @@ void ImageApplication::InitializeGUI() {
     mainWindow->setMinimumSize(800, 600);
 
     imageDataManager = new ImageDataManager(this);
+    directoryScanner = new DirectoryScanner(this);
+    directoryWatcher = new DirectoryWatcher(this);
     imageViewer = new ImageViewerWidget(mainWindow);
     imageGallery = new ImageGalleryWidget(mainWindow);
     undoStack = new QUndoStack(this);
     settings = new QSettings(QCoreApplication::organizationName(), QCoreApplication::applicationName(), this);
+    imageDataManager->setCacheLimit(settings->value("cache/maxMegabytes", 512).toLongLong() * 1024 * 1024);
+    imageDataManager->setProgressiveLoading(settings->value("viewer/progressiveDisplay", true).toBool());
+    // Snapshots spill to disk under memory pressure, but disk is not free either
+    undoStack->setUndoLimit(settings->value("undo/maxSteps", 50).toInt());
+
+    // Disk reads and decodes are capped separately; 0 keeps the scheduler's defaults
+    const int ioThreads = settings->value("scheduler/ioThreads", 0).toInt();
+    const int cpuThreads = settings->value("scheduler/cpuThreads", 0).toInt();
+    if (ioThreads > 0) DecodeScheduler::instance()->setIoConcurrency(ioThreads);
+    if (cpuThreads > 0) DecodeScheduler::instance()->setCpuConcurrency(cpuThreads);
+
+    // One budget for all decoded pixels: cache, undo history, thumbnails and the view itself
+    ImageMemoryGovernor* governor = ImageMemoryGovernor::instance();
+    governor->setBudget(settings->value("memory/budgetMB", 1024).toLongLong() * 1024 * 1024);
+    undoMemoryConsumer = governor->registerConsumer(ImageMemoryGovernor::UndoSnapshots, "Undo history",
+                                                    [this](qint64 bytesToFree) { return spillUndoSnapshots(bytesToFree); });
 
     mainWindow->setCentralWidget(imageViewer);
 
@@ -130,11 +254,16 @@ void ImageApplication::InitializeGUI() {
     galleryDock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
     mainWindow->addDockWidget(Qt::LeftDockWidgetArea, galleryDock);
 
+    memoryStatusLabel = new QLabel(mainWindow);
+    mainWindow->statusBar()->addPermanentWidget(memoryStatusLabel);
+
     createActions();
     createMenus();
     createToolbars();
     connectSignalsAndSlots();
 
+    ComplyWithFreeDesktopThumbnailSpec(); // Before the first directory is listed
+
     bool darkModeEnabled = settings->value("darkMode", false).toBool();
     EnableDarkMode(darkModeEnabled);
 
@@ -155,60 +284,403 @@ void ImageApplication::RegisterFileTypes() {}
 
 void ImageApplication::OpenImageFile(const QString& path) {
     qDebug() << "Opening image file:" << path;
-    QImage img = imageDataManager->loadImage(path);
-    if (!img.isNull()) {
-        undoStack->clear(); // Clear undo history when opening a new image
-        imageViewer->setImage(img); // Sets m_originalImage and resets transformations
-
-        QFileInfo fileInfo(path);
-        mainWindow->setWindowTitle("imageview - " + fileInfo.fileName());
-
-        // Fix for Next/Prev: Ensure currentDirectory and imageList are correctly populated
-        // and currentImageIndex is set when a specific file is opened.
-        QString dirPath = fileInfo.absolutePath();
-        if (dirPath != currentDirectory) {
-            // If opening a file from a new directory, update the gallery and list
-            OpenImageDirectory(dirPath); // This will reload gallery and set list
-            // However, after this, need to ensure THIS image is selected
-            imageGallery->selectImage(path);
-            currentImageIndex = imageList.indexOf(path);
-        } else {
-            // If it's from the current directory, just select it in gallery
-            imageGallery->selectImage(path);
-            currentImageIndex = imageList.indexOf(path);
-        }
+    QFileInfo fileInfo(path);
+
+    // Fix for Next/Prev: Ensure currentDirectory and imageList are correctly populated
+    // and currentImageIndex is set when a specific file is opened.
+    QString dirPath = fileInfo.absolutePath();
+    if (dirPath != currentDirectory) {
+        // A file from another directory opens right away; its directory is listed meanwhile
+        startDirectoryScan(dirPath, fileInfo.fileName());
+    }
+    // imageList holds file names relative to currentDirectory
+    currentImageIndex = imageList.indexOf(fileInfo.fileName());
+    if (currentImageIndex != -1) {
+        imageGallery->selectImage(path);
+    } else if (directoryScanRequest != 0) {
+        pendingSelection = fileInfo.fileName(); // Selected once the listing reaches it
+    } else if (!path.isEmpty()) {
         // If image not found in list (e.g., just opened a random single file),
         // then navigation will be limited to just this file if we implement it that way.
         // For simplicity, ensure it's in list for navigation:
-        if (currentImageIndex == -1 && !path.isEmpty()) {
-            imageList.clear();
-            imageList.append(path);
-            currentImageIndex = 0;
+        imageList.clear();
+        imageList.append(path);
+        currentImageIndex = 0;
+    }
+
+    // Decode off the GUI thread. Requesting a new image supersedes any decode still
+    // in flight, so only the most recent request ends up in handleImageLoaded().
+    fullResolutionActions.clear(); // They were meant for the previous image
+    fullResolutionRequest = 0;
+    pendingLoadRequest = imageDataManager->loadImageAsync(path, viewportDecodeSize());
+    prefetchNeighbors();
+}
+
+QSize ImageApplication::viewportDecodeSize() const {
+    if (!settings->value("viewer/decodeForViewport", true).toBool()) {
+        return QSize();
+    }
+    // Decode for the screen rather than the widget: the result then survives window
+    // resizes and fullscreen, and full resolution is fetched only when zooming past 1:1.
+    QScreen* screen = QGuiApplication::primaryScreen();
+    if (!screen) return QSize();
+    return screen->size() * screen->devicePixelRatio();
+}
+
+void ImageApplication::prefetchNeighbors() {
+    if (imageList.size() < 2 || currentImageIndex == -1) return;
+
+    const int ahead = settings->value("prefetch/ahead", 2).toInt();
+    const int behind = settings->value("prefetch/behind", 1).toInt();
+    const int size = imageList.size();
+
+    // Interleave next/previous so the most likely targets are decoded first
+    QStringList paths;
+    for (int distance = 1; distance <= qMax(ahead, behind); ++distance) {
+        if (distance <= ahead) {
+            int index = (currentImageIndex + distance) % size;
+            if (index != currentImageIndex) paths << QDir(currentDirectory).filePath(imageList.at(index));
+        }
+        if (distance <= behind) {
+            int index = ((currentImageIndex - distance) % size + size) % size;
+            if (index != currentImageIndex) paths << QDir(currentDirectory).filePath(imageList.at(index));
         }
+    }
+    paths.removeDuplicates();
+    imageDataManager->prefetchImages(paths, viewportDecodeSize());
+}
 
-    } else {
-        QMessageBox::warning(mainWindow, "Error", "Could not open image file:\n" + path);
+void ImageApplication::handleImageLoaded(quint64 requestId, const QString& path, const QImage& image, const QSize& sourceSize) {
+    if (requestId != pendingLoadRequest) return; // The user already moved on to another image
+
+    if (requestId == fullResolutionRequest) {
+        fullResolutionRequest = 0;
+        imageViewer->setFullResolutionImage(image); // Keeps zoom, rotation and undo history
+        runFullResolutionActions();
+        return;
+    }
+
+    undoStack->clear(); // Clear undo history when opening a new image
+    imageViewer->setImage(image, sourceSize, path); // Sets m_originalImage and resets transformations
+    imageViewer->playAnimation(path);         // No-op for still images
+    displayedImagePath = path;
+    mainWindow->setWindowTitle("imageview - " + QFileInfo(path).fileName());
+
+    runFullResolutionActions(); // Queued while this image was still a progressive stand-in
+
+    ImageCacheStats stats = imageDataManager->cacheStats();
+    qDebug() << "Image cache:" << stats.hits << "hits," << stats.misses << "misses," << stats.evictions << "evictions,"
+             << stats.entries << "entries," << stats.bytes / (1024 * 1024) << "/" << stats.maxBytes / (1024 * 1024) << "MB";
+}
+
+void ImageApplication::handleImagePartiallyLoaded(quint64 requestId, const QString& path, const QImage& image, const QSize& sourceSize) {
+    if (requestId != pendingLoadRequest || requestId == fullResolutionRequest) return;
+    // Undo history and displayedImagePath belong to the final image, see handleImageLoaded()
+    imageViewer->setProgressiveImage(image, sourceSize, path);
+    mainWindow->setWindowTitle("imageview - " + QFileInfo(path).fileName());
+}
+
+void ImageApplication::handleImageLoadFailed(quint64 requestId, const QString& path, const QString& errorString) {
+    if (requestId != pendingLoadRequest) return;
+    const bool actionsPending = !fullResolutionActions.isEmpty();
+    fullResolutionActions.clear();
+    if (requestId == fullResolutionRequest) {
+        fullResolutionRequest = 0;
+        qWarning() << "Full-resolution decode failed, keeping the preview:" << path << errorString;
+        if (actionsPending) {
+            QMessageBox::warning(mainWindow, "Error", "Could not load the full-resolution image:\n" + path + "\n" + errorString);
+        }
+        return;
+    }
+    if (imageViewer->isProgressive()) {
+        // The stand-in of an image that never arrived must not stay up to be edited or saved
+        imageViewer->setImage(QImage());
+        displayedImagePath.clear();
+        undoStack->clear(); // It belonged to the image the stand-in replaced
+        mainWindow->setWindowTitle("imageview");
+    }
+    QMessageBox::warning(mainWindow, "Error", "Could not open image file:\n" + path + "\n" + errorString);
+}
+
+void ImageApplication::handleHeadersReady(quint64 batchId, const QHash<QString, ImageHeaderInfo>& headers) {
+    if (batchId != headerBatchRequest) return; // From a directory we already left
+    headerBatchRequest = 0;
+    // Merged: after the directory's batch, smaller ones follow for files that changed on disk
+    for (auto it = headers.constBegin(); it != headers.constEnd(); ++it) {
+        imageHeaders.insert(it.key(), it.value());
+    }
+    imageGallery->setImageHeaders(headers);
+    if (sortMode != ByName) {
+        SortImages(sortMode);
+    }
+}
+
+void ImageApplication::handleFullResolutionRequested() {
+    if (displayedImagePath.isEmpty() || fullResolutionRequest != 0) return;
+    if (TiledImageSource::shouldUseTiles(imageViewer->sourceSize())) {
+        // Too big for one QImage: let the viewer decode only the tiles it shows
+        QSharedPointer<TiledImageSource> tiled = TiledImageSource::open(displayedImagePath);
+        if (tiled) {
+            qDebug() << "Zoomed past 1:1, switching to tiled rendering:" << displayedImagePath;
+            imageViewer->setTiledSource(tiled);
+        } else {
+            // A whole decode would be hundreds of MB; the reduced image is magnified instead
+            qDebug() << "Zoomed past 1:1, no tiled decoder, keeping the reduced image:" << displayedImagePath;
+        }
+        return;
+    }
+    qDebug() << "Zoomed past 1:1, loading full resolution:" << displayedImagePath;
+    requestFullResolution();
+}
+
+void ImageApplication::requestFullResolution() {
+    pendingLoadRequest = imageDataManager->loadImageAsync(displayedImagePath);
+    fullResolutionRequest = pendingLoadRequest;
+}
+
+bool ImageApplication::deferUntilFullResolution(const std::function<void()>& action) {
+    if (!imageViewer->isPreview()) return false;
+    // A progressive stand-in is followed by its decode, which may already be full resolution
+    if (!imageViewer->isProgressive() && fullResolutionRequest == 0) {
+        if (TiledImageSource::shouldUseTiles(imageViewer->sourceSize()) || displayedImagePath.isEmpty()) {
+            QMessageBox::warning(mainWindow, "Image Too Large",
+                                 "This image is too large to hold in memory at full resolution.\n"
+                                 "It can be viewed, but not edited or exported.");
+            return true;
+        }
+        requestFullResolution();
+    }
+    fullResolutionActions.append(action);
+    mainWindow->statusBar()->showMessage("Loading full resolution...", 2000);
+    return true;
+}
+
+void ImageApplication::runFullResolutionActions() {
+    // An action finding the image still reduced queues itself again
+    const QList<std::function<void()>> actions = fullResolutionActions;
+    fullResolutionActions.clear();
+    for (const std::function<void()>& action : actions) {
+        action();
     }
 }
 
 void ImageApplication::OpenImageDirectory(const QString& directory) {
     qDebug() << "Opening image directory:" << directory;
-    currentDirectory = directory;
-    imageGallery->loadImagesFromDirectory(directory); // This populates the gallery and internal list
+    startDirectoryScan(directory, QString()); // The first image found is opened, see handleDirectoryEntries()
+}
+
+void ImageApplication::startDirectoryScan(const QString& directory, const QString& selection) {
+    // One listing feeds both imageList and the gallery, so the two always agree
+    currentDirectory = QDir(directory).absolutePath();
+    imageList.clear();
+    currentImageIndex = -1;
+    pendingSelection = selection;
+    imageHeaders.clear();
+    headerBatchRequest = 0; // Headers of the previous directory are no longer wanted
+    deferredDirectoryChanges.clear();
+    imageDataManager->clearModificationTimes(); // Files may have changed while nobody watched
+    imageGallery->setDirectory(currentDirectory);
+    // Watch before listing, so nothing that changes during the scan goes unnoticed
+    directoryWatcher->watch(currentDirectory);
+    directoryScanRequest = directoryScanner->scan(currentDirectory);
+}
+
+void ImageApplication::handleDirectoryEntries(quint64 scanId, const QStringList& fileNames) {
+    if (scanId != directoryScanRequest) return; // From a directory we already left
+    const int firstNew = imageList.size();
+    for (const QString& fileName : fileNames) {
+        imageList.append(fileName);
+    }
+    imageGallery->addImages(fileNames);
+
+    if (currentImageIndex != -1) return;
+    if (!pendingSelection.isEmpty()) {
+        const int index = fileNames.indexOf(pendingSelection);
+        if (index >= 0) {
+            currentImageIndex = firstNew + index;
+            imageGallery->selectImage(QDir(currentDirectory).filePath(pendingSelection));
+            pendingSelection.clear();
+            prefetchNeighbors();
+        }
+    } else if (!fileNames.isEmpty()) {
+        // Open the first image as soon as it is found instead of after the full listing
+        OpenImageFile(QDir(currentDirectory).filePath(fileNames.first()));
+    }
+}
+
+void ImageApplication::handleDirectoryScanFinished(quint64 scanId, int count) {
+    if (scanId != directoryScanRequest) return;
+    directoryScanRequest = 0;
+    qDebug() << "Listed" << count << "images in" << currentDirectory;
+    if (!deferredDirectoryChanges.isEmpty()) {
+        // The listing may or may not have seen these; applyDirectoryChanges() checks the disk either way
+        const QStringList changes = deferredDirectoryChanges;
+        deferredDirectoryChanges.clear();
+        applyDirectoryChanges(changes);
+    }
+
+    const QString selectedPath = pendingSelection.isEmpty() ? QString() : QDir(currentDirectory).filePath(pendingSelection);
+    if (imageList.isEmpty()) {
+        if (!selectedPath.isEmpty() && QFileInfo(selectedPath).isFile()) {
+            // The opened file is the only one here, under a name the listing does not match
+            pendingSelection.clear();
+            imageList.append(selectedPath);
+            currentImageIndex = 0;
+        } else {
+            clearDisplayedImage();
+        }
+        return;
+    }
+
+    // Entries arrived in directory order; put them in the selected order once
+    SortImages(sortMode);
+
+    // Dimensions, capture time and camera for the whole directory, without decoding pixels
+    QDir dir(currentDirectory);
+    QStringList paths;
+    paths.reserve(imageList.size());
+    for (const QString& fileName : imageList) {
+        paths << dir.filePath(fileName);
+    }
+    headerBatchRequest = imageDataManager->readHeadersAsync(paths);
+
+    if (!pendingSelection.isEmpty()) {
+        const int index = imageList.indexOf(pendingSelection); // Listed through a deferred change
+        pendingSelection.clear();
+        if (index >= 0) {
+            currentImageIndex = index;
+            imageGallery->selectImage(selectedPath);
+            prefetchNeighbors();
+        } else if (QFileInfo(selectedPath).isFile()) {
+            // The opened file is not one of the listed images (e.g. an unusual extension);
+            // navigate just that file, as before
+            imageList.clear();
+            imageList.append(selectedPath);
+            currentImageIndex = 0;
+        }
+        // Otherwise it was deleted meanwhile; the watcher reports that and the viewer moves on
+    }
+}
+
+void ImageApplication::clearDisplayedImage() {
+    imageDataManager->cancelPendingLoads(); // Don't let a late result from the previous image show up
+    pendingLoadRequest = 0;
+    fullResolutionRequest = 0;
+    fullResolutionActions.clear();
+    currentImageIndex = -1;
+    displayedImagePath.clear();
+    imageViewer->setImage(QImage());
+    mainWindow->setWindowTitle("imageview - No images in " + currentDirectory);
+    undoStack->clear(); // Clear undo history if no images are loaded
+}
+
+void ImageApplication::handleDirectoryEntriesChanged(const QStringList& fileNames) {
+    if (directoryScanRequest != 0) {
+        deferredDirectoryChanges << fileNames; // imageList is still incomplete, diff against it later
+        return;
+    }
+    applyDirectoryChanges(fileNames);
+}
+
+void ImageApplication::handleDirectoryRescanNeeded() {
+    if (currentDirectory.isEmpty()) return;
+    qDebug() << "Directory change events were lost, listing again:" << currentDirectory;
+    const QString current = (currentImageIndex >= 0 && currentImageIndex < imageList.size())
+        ? imageList.at(currentImageIndex) : QString();
+    startDirectoryScan(currentDirectory, current);
+}
+
+void ImageApplication::applyDirectoryChanges(const QStringList& fileNames) {
+    // The watcher only says which names were touched; the disk says what happened to them
+    const QDir dir(currentDirectory);
+    const QStringList filters = DirectoryScanner::nameFilters();
+    // One pass over imageList per batch; a burst can touch thousands of names in a folder as large
+    QHash<QString, int> rows;
+    rows.reserve(imageList.size());
+    for (int row = 0; row < imageList.size(); ++row) rows.insert(imageList.at(row), row);
+    QStringList added, removed, modified;
+    for (const QString& fileName : fileNames) {
+        const bool exists = QDir::match(filters, fileName) && QFileInfo(dir.filePath(fileName)).isFile();
+        const bool listed = rows.contains(fileName);
+        if (exists && listed) modified << fileName;
+        else if (exists) added << fileName;
+        else if (listed) removed << fileName;
+    }
+    if (added.isEmpty() && removed.isEmpty() && modified.isEmpty()) return;
+    qDebug() << "Directory changed:" << added.size() << "added," << removed.size() << "removed," << modified.size() << "modified";
+
+    // Cache keys must not use the old modification times until the new headers are in
+    QStringList changedPaths;
+    for (const QString& fileName : removed + modified) changedPaths << dir.filePath(fileName);
+    imageDataManager->forgetModificationTimes(changedPaths);
+
+    const QString currentName = (currentImageIndex >= 0 && currentImageIndex < imageList.size())
+        ? imageList.at(currentImageIndex) : QString();
+    int replacementIndex = -1; // Where the displayed image was, if it was deleted
+    if (!removed.isEmpty()) {
+        QVector<bool> dropped(imageList.size(), false);
+        for (const QString& fileName : removed) {
+            dropped[rows.value(fileName)] = true;
+            imageHeaders.remove(dir.filePath(fileName));
+        }
+        // Compact in place instead of a remove() per name
+        int kept = 0;
+        currentImageIndex = -1;
+        for (int row = 0; row < imageList.size(); ++row) {
+            const bool isCurrent = !currentName.isEmpty() && imageList.at(row) == currentName;
+            if (dropped.at(row)) {
+                if (isCurrent) replacementIndex = kept;
+                continue;
+            }
+            if (isCurrent) currentImageIndex = kept;
+            if (kept != row) imageList[kept] = imageList.at(row);
+            ++kept;
+        }
+        imageList.resize(kept);
+        imageGallery->removeImages(removed);
+    }
 
-    QDir dir(directory);
-    QStringList filters;
-    filters << "*.png" << "*.jpg" << "*.jpeg" << "*.bmp" << "*.gif" << "*.tiff" << "*.tif";
-    imageList = QVector<QString>::fromList(dir.entryList(filters, QDir::Files | QDir::NoDotAndDotDot, QDir::Name));
+    if (!added.isEmpty()) {
+        for (const QString& fileName : added) {
+            imageList.append(fileName);
+        }
+        imageGallery->addImages(added);
+        SortImages(sortMode); // Also restores currentImageIndex and the gallery order
+    }
+    if (!modified.isEmpty()) {
+        imageGallery->refreshImages(modified);
+    }
 
-    currentImageIndex = -1; // Reset index
+    // Headers for the new and rewritten files; a directory batch still running is reissued whole
+    QStringList headerPaths;
+    if (headerBatchRequest != 0) {
+        for (const QString& fileName : imageList) headerPaths << dir.filePath(fileName);
+    } else {
+        for (const QString& fileName : added + modified) headerPaths << dir.filePath(fileName);
+    }
+    if (!headerPaths.isEmpty()) {
+        headerBatchRequest = imageDataManager->readHeadersAsync(headerPaths);
+    }
+
+    // Our own export over the displayed file shows what the viewer already has; reloading it
+    // would only throw away the undo history
+    bool rewrittenElsewhere = false;
+    if (modified.contains(currentName)) {
+        const QString path = dir.filePath(currentName);
+        rewrittenElsewhere = !ownWrites.contains(path) || ownWrites.value(path) != QFileInfo(path).lastModified();
+    }
 
-    if (!imageList.isEmpty()) {
-        OpenImageFile(QDir(currentDirectory).filePath(imageList.first()));
+    if (imageList.isEmpty()) {
+        clearDisplayedImage(); // The last image was deleted
+    } else if (replacementIndex >= 0) {
+        // The displayed image was deleted: show the one that took its place
+        OpenImageFile(dir.filePath(imageList.at(qMin(replacementIndex, imageList.size() - 1))));
+    } else if (rewrittenElsewhere) {
+        OpenImageFile(dir.filePath(currentName)); // Rewritten on disk, e.g. by an editor; cache keys include the mtime
+    } else if (currentImageIndex == -1 && displayedImagePath.isEmpty() && !added.isEmpty()) {
+        OpenImageFile(dir.filePath(imageList.first())); // First file dropped into an empty folder
     } else {
-        imageViewer->setImage(QImage());
-        mainWindow->setWindowTitle("imageview - No images in " + directory);
-        undoStack->clear(); // Clear undo history if no images are loaded
+        prefetchNeighbors(); // Neighbors changed with the list
     }
 }
 
@@ -252,7 +724,7 @@ void ImageApplication::ToggleFullscreen() {
 }
 
 void ImageApplication::ToggleZoom(ZoomMode mode) {
-    if (!imageViewer || imageViewer->currentImage().isNull()) return;
+    if (!imageViewer || !imageViewer->hasImage()) return;
     if (mode == ActualSize) {
         imageViewer->setZoomFactor(1.0);
     } else if (mode == FitToScreen) {
@@ -260,10 +732,10 @@ void ImageApplication::ToggleZoom(ZoomMode mode) {
     }
 }
 
-ImageViewerState ImageApplication::getCurrentImageViewerState() const {
+ImageViewerState ImageApplication::getCurrentImageViewerState(bool withImage) const {
     ImageViewerState state;
     if (imageViewer) {
-        state.image = imageViewer->getOriginalImage(); // Get the base image
+        if (withImage) state.image = imageViewer->getOriginalImage(); // Get the base image
         state.zoomFactor = imageViewer->getZoomFactor();
         state.rotationAngle = imageViewer->getRotationAngle();
         state.flippedHorizontal = imageViewer->getFlipHorizontal();
@@ -278,7 +750,7 @@ void ImageApplication::ShowImageMetadata() {
     QString currentImagePath;
     if (!imageList.isEmpty() && currentImageIndex != -1 && currentImageIndex < imageList.size()) {
         currentImagePath = QDir(currentDirectory).filePath(imageList.at(currentImageIndex));
-    } else if (imageViewer && !imageViewer->currentImage().isNull()) {
+    } else if (imageViewer && imageViewer->hasImage()) {
         // Fallback for pasted images or images opened individually not in a directory list
         // For these, we don't have a path, so basic file system metadata is unavailable.
         QMessageBox::information(mainWindow, "Image Metadata", "Metadata is available only for images opened from disk. Please save the image to disk first.");
@@ -311,7 +783,41 @@ void ImageApplication::ShowImageMetadata() {
 void ImageApplication::RenameImage(const QString& newName) { Q_UNUSED(newName); }
 void ImageApplication::DeleteImage() {}
 void ImageApplication::MoveImageTo(const QString& destinationPath) { Q_UNUSED(destinationPath); }
-void ImageApplication::SortImages(SortMode mode) { Q_UNUSED(mode); }
+void ImageApplication::SortImages(SortMode mode) {
+    sortMode = mode;
+    if (imageList.size() < 2) return;
+    const QString currentName = (currentImageIndex >= 0 && currentImageIndex < imageList.size())
+        ? imageList.at(currentImageIndex) : QString();
+
+    // Precompute the sort keys once instead of looking headers up in every comparison
+    struct SortEntry { QString name; QDateTime captureTime; qint64 pixels; };
+    QVector<SortEntry> entries;
+    entries.reserve(imageList.size());
+    QDir dir(currentDirectory);
+    for (const QString& name : imageList) {
+        const ImageHeaderInfo header = imageHeaders.value(dir.filePath(name));
+        entries.append({name, header.captureTime, qint64(header.size.width()) * header.size.height()});
+    }
+    std::stable_sort(entries.begin(), entries.end(), [mode](const SortEntry& a, const SortEntry& b) {
+        if (mode == ByDate && a.captureTime != b.captureTime) {
+            if (a.captureTime.isValid() != b.captureTime.isValid()) return a.captureTime.isValid(); // Undated last
+            return a.captureTime < b.captureTime;
+        }
+        if (mode == BySize && a.pixels != b.pixels) {
+            return a.pixels > b.pixels; // Largest first
+        }
+        return a.name < b.name; // Same order as QDir::Name
+    });
+
+    QStringList order;
+    for (int i = 0; i < entries.size(); ++i) {
+        imageList[i] = entries.at(i).name;
+        order << entries.at(i).name;
+    }
+    currentImageIndex = imageList.indexOf(currentName);
+    imageGallery->setImageOrder(order);
+    prefetchNeighbors(); // Neighbors changed with the order
+}
 void ImageApplication::FilterImages(FilterCriteria criteria) { Q_UNUSED(criteria); }
 void ImageApplication::EnableDragAndDrop() {}
 
@@ -356,10 +862,10 @@ void ImageApplication::CropImage(Rect region) { Q_UNUSED(region); }
 void ImageApplication::ResizeImage(int width, int height) { Q_UNUSED(width); Q_UNUSED(height); }
 
 void ImageApplication::RotateImage(int angle) {
-    if (!imageViewer || imageViewer->currentImage().isNull()) return;
-    ImageViewerState oldState = getCurrentImageViewerState(); // Get state before operation
+    if (!imageViewer || !imageViewer->hasImage()) return;
+    ImageViewerState oldState = getCurrentImageViewerState(false); // Get state before operation
     imageViewer->rotate(angle);
-    ImageViewerState newState = getCurrentImageViewerState(); // Get state after operation
+    ImageViewerState newState = getCurrentImageViewerState(false); // Get state after operation
     undoStack->push(new ImageTransformCommand(imageViewer, oldState, newState, "Rotate"));
 }
 
@@ -369,7 +875,9 @@ void ImageApplication::AddTextOverlay(const QString& text, Point position) { Q_U
 void ImageApplication::DrawAnnotation(Shape shape) { Q_UNUSED(shape); }
 
 void ImageApplication::ApplyFilter(FilterType filter) {
-    if (!imageViewer || imageViewer->currentImage().isNull()) return;
+    if (!imageViewer || !imageViewer->hasImage()) return;
+    // Filters change pixels, so they run on the full-resolution image only
+    if (filter != Normal && deferUntilFullResolution([this, filter]() { ApplyFilter(filter); })) return;
 
     ImageViewerState oldState = getCurrentImageViewerState(); // Get state before filter
 
@@ -381,7 +889,7 @@ void ImageApplication::ApplyFilter(FilterType filter) {
         imageViewer->applyNegative();
     } else if (filter == Normal) {
         // "Normal" means reset image data and all transformations
-        imageViewer->setImage(imageViewer->getOriginalImageSource()); // Reset to original source image (unfiltered, un-transformed)
+        imageViewer->setImage(imageViewer->getOriginalImageSource(), imageViewer->sourceSize()); // Reset to original source image (unfiltered, un-transformed)
         // This action clears viewer's transformations by design, so no need to explicitly set them to 0 here.
         undoStack->clear(); // Clear undo history for "Normal" as it's a full reset point
         return; // Don't push to undo stack as it's a reset
@@ -396,10 +904,11 @@ void ImageApplication::EnableSelectionTool(SelectionType type) { Q_UNUSED(type);
 void ImageApplication::LoadPlugins(const QString& pluginPath) { Q_UNUSED(pluginPath); }
 
 void ImageApplication::ExportToFormat(const QString& format) {
-    if (!imageViewer || imageViewer->currentImage().isNull()) {
+    if (!imageViewer || !imageViewer->hasImage()) {
         QMessageBox::warning(mainWindow, "Export Error", "No image to export.");
         return;
     }
+    if (deferUntilFullResolution([this, format]() { ExportToFormat(format); })) return;
 
     QString filter;
     if (format == "BMP") filter = "Bitmap (*.bmp)";
@@ -413,6 +922,8 @@ void ImageApplication::ExportToFormat(const QString& format) {
     if (filePath.isEmpty()) return;
 
     if (imageViewer->currentImage().save(filePath, qPrintable(format.toUpper()))) {
+        const QFileInfo written(filePath);
+        ownWrites.insert(written.absoluteFilePath(), written.lastModified()); // The watcher will report it back
         QMessageBox::information(mainWindow, "Export Successful", "Image exported successfully.");
     } else {
         QMessageBox::warning(mainWindow, "Export Error", "Failed to export image to " + format + " format.");
@@ -420,10 +931,11 @@ void ImageApplication::ExportToFormat(const QString& format) {
 }
 
 void ImageApplication::PrintImage() {
-    if (!imageViewer || imageViewer->currentImage().isNull()) {
+    if (!imageViewer || !imageViewer->hasImage()) {
         QMessageBox::warning(mainWindow, "Print Error", "No image to print.");
         return;
     }
+    if (deferUntilFullResolution([this]() { PrintImage(); })) return;
 
     QPrinter printer;
     QPrintDialog printDialog(&printer, mainWindow);
@@ -441,7 +953,8 @@ void ImageApplication::PrintImage() {
 }
 
 void ImageApplication::CopyToClipboard() {
-    if (imageViewer && !imageViewer->currentImage().isNull()) {
+    if (imageViewer && imageViewer->hasImage()) {
+        if (deferUntilFullResolution([this]() { CopyToClipboard(); })) return;
         QApplication::clipboard()->setImage(imageViewer->currentImage());
         qDebug() << "Image copied to clipboard.";
     } else {
@@ -455,8 +968,17 @@ void ImageApplication::PasteFromClipboard() {
         QImage pastedImage = clipboard->image();
         if (!pastedImage.isNull()) {
             qDebug() << "Image pasted from clipboard.";
+            imageDataManager->cancelPendingLoads(); // A pending file load must not replace the pasted image
+            pendingLoadRequest = 0;
+            fullResolutionRequest = 0;
+            fullResolutionActions.clear();
+            displayedImagePath.clear();
             imageViewer->setImage(pastedImage);
             mainWindow->setWindowTitle("imageview - (Pasted Image)");
+            directoryScanner->cancel();
+            directoryWatcher->stop();
+            directoryScanRequest = 0;
+            pendingSelection.clear();
             imageGallery->clear();
             imageList.clear();
             currentImageIndex = -1;
@@ -479,7 +1001,15 @@ void ImageApplication::SyncWithCloudProvider(const QString& providerName) { Q_UN
 
 void ImageApplication::UseGdkPixbufOrVIPS() {}
 void ImageApplication::FollowXDGDirectorySpecs() {}
-void ImageApplication::ComplyWithFreeDesktopThumbnailSpec() {}
+void ImageApplication::ComplyWithFreeDesktopThumbnailSpec() {
+    // Share thumbnails with file managers and other viewers via ~/.cache/thumbnails
+    const bool enabled = settings->value("thumbnails/sharedCache", true).toBool() && ThumbnailCache::ensureDirectories();
+    imageGallery->setThumbnailCacheEnabled(enabled);
+    // Otherwise a private cache keeps size and screen changes free of decodes
+    const ThumbnailCache::Store store = enabled ? ThumbnailCache::Shared : ThumbnailCache::Private;
+    if (!enabled) ThumbnailCache::ensureDirectories(store);
+    qDebug() << (enabled ? "Shared" : "Private") << "thumbnail cache" << ThumbnailCache::cacheDirectory(store);
+}
 
 void ImageApplication::EnableAsyncImageLoading() {}
 void ImageApplication::OptimizeMemoryUsage() {}
@@ -593,6 +1123,39 @@ void ImageApplication::createActions() {
     metadataAct->setShortcut(QKeySequence("F10"));
     connect(metadataAct, &QAction::triggered, this, &ImageApplication::handleShowMetadata);
 
+    // Sorting uses header metadata (capture time, pixel size) read in the background
+    QActionGroup* sortGroup = new QActionGroup(mainWindow);
+    sortByNameAct = new QAction("By &Name", sortGroup);
+    sortByNameAct->setCheckable(true);
+    sortByNameAct->setChecked(true);
+    connect(sortByNameAct, &QAction::triggered, [this](){ SortImages(ByName); });
+
+    sortByDateAct = new QAction("By &Date Taken", sortGroup);
+    sortByDateAct->setCheckable(true);
+    connect(sortByDateAct, &QAction::triggered, [this](){ SortImages(ByDate); });
+
+    sortBySizeAct = new QAction("By Image &Size", sortGroup);
+    sortBySizeAct->setCheckable(true);
+    connect(sortBySizeAct, &QAction::triggered, [this](){ SortImages(BySize); });
+
+    // Gallery thumbnail size; every size comes from the same cached mip chain
+    const int thumbnailSize = settings->value("gallery/thumbnailSize", 128).toInt();
+    imageGallery->setThumbnailSize(thumbnailSize);
+    QActionGroup* thumbnailSizeGroup = new QActionGroup(mainWindow);
+    auto addThumbnailSizeAction = [this, thumbnailSizeGroup, thumbnailSize](const QString& text, int size) {
+        QAction* action = new QAction(text, thumbnailSizeGroup);
+        action->setCheckable(true);
+        action->setChecked(size == thumbnailSize);
+        connect(action, &QAction::triggered, [this, size]() {
+            imageGallery->setThumbnailSize(size);
+            settings->setValue("gallery/thumbnailSize", size);
+        });
+        return action;
+    };
+    thumbnailSmallAct = addThumbnailSizeAction("&Small", 64);
+    thumbnailMediumAct = addThumbnailSizeAction("&Medium", 128);
+    thumbnailLargeAct = addThumbnailSizeAction("&Large", 256);
+
     aboutAct = new QAction("&About...", mainWindow);
     connect(aboutAct, &QAction::triggered, this, &ImageApplication::handleAboutAction);
 
@@ -617,6 +1180,9 @@ void ImageApplication::createActions() {
     mainWindow->addAction(nextImageAct);
     mainWindow->addAction(prevImageAct);
     mainWindow->addAction(darkModeAct);
+    mainWindow->addAction(sortByNameAct);
+    mainWindow->addAction(sortByDateAct);
+    mainWindow->addAction(sortBySizeAct);
 
     mainWindow->addAction(rotateRightAct);
     mainWindow->addAction(rotateLeftAct);
@@ -657,6 +1223,14 @@ void ImageApplication::createMenus() {
     viewMenu->addSeparator();
     viewMenu->addAction(nextImageAct);
     viewMenu->addAction(prevImageAct);
+    QMenu* sortMenu = viewMenu->addMenu("&Sort Images");
+    sortMenu->addAction(sortByNameAct);
+    sortMenu->addAction(sortByDateAct);
+    sortMenu->addAction(sortBySizeAct);
+    QMenu* thumbnailSizeMenu = viewMenu->addMenu("&Thumbnail Size");
+    thumbnailSizeMenu->addAction(thumbnailSmallAct);
+    thumbnailSizeMenu->addAction(thumbnailMediumAct);
+    thumbnailSizeMenu->addAction(thumbnailLargeAct);
     viewMenu->addSeparator();
     viewMenu->addAction(darkModeAct);
 
@@ -710,17 +1284,60 @@ void ImageApplication::createToolbars() {
 }
 
 void ImageApplication::connectSignalsAndSlots() {
-    connect(imageDataManager, &ImageDataManager::imageLoaded, imageViewer, &ImageViewerWidget::setImage);
+    connect(imageDataManager, &ImageDataManager::imageLoadFinished, this, &ImageApplication::handleImageLoaded);
+    connect(imageDataManager, &ImageDataManager::imagePartiallyLoaded, this, &ImageApplication::handleImagePartiallyLoaded);
+    connect(imageDataManager, &ImageDataManager::imageLoadFailed, this, &ImageApplication::handleImageLoadFailed);
+    connect(imageDataManager, &ImageDataManager::headersReady, this, &ImageApplication::handleHeadersReady);
+    connect(directoryScanner, &DirectoryScanner::entriesFound, this, &ImageApplication::handleDirectoryEntries);
+    connect(directoryScanner, &DirectoryScanner::scanFinished, this, &ImageApplication::handleDirectoryScanFinished);
+    connect(directoryWatcher, &DirectoryWatcher::entriesChanged, this, &ImageApplication::handleDirectoryEntriesChanged);
+    connect(directoryWatcher, &DirectoryWatcher::rescanNeeded, this, &ImageApplication::handleDirectoryRescanNeeded);
+    connect(imageViewer, &ImageViewerWidget::fullResolutionRequested, this, &ImageApplication::handleFullResolutionRequested);
     connect(imageGallery, &ImageGalleryWidget::imageSelected, this, &ImageApplication::handleThumbnailClicked);
 
+    connect(undoStack, &QUndoStack::indexChanged, this, &ImageApplication::reportUndoUsage);
+    connect(ImageMemoryGovernor::instance(), &ImageMemoryGovernor::usageChanged, this, [this](qint64 total, qint64 budget) {
+        memoryStatusLabel->setText(QString("Memory: %1 / %2 MB").arg(total / (1024 * 1024)).arg(budget / (1024 * 1024)));
+        memoryStatusLabel->setToolTip(ImageMemoryGovernor::instance()->usageSummary());
+    });
     connect(undoStack, &QUndoStack::canUndoChanged, undoAct, &QAction::setEnabled);
     connect(undoStack, &QUndoStack::canRedoChanged, redoAct, &QAction::setEnabled);
     undoAct->setEnabled(false);
     redoAct->setEnabled(false);
 }
 
+void ImageApplication::reportUndoUsage() {
+    // Consecutive commands share snapshots (one's new state is the next one's old state)
+    QSet<qint64> counted;
+    qint64 bytes = 0;
+    for (int i = 0; i < undoStack->count(); ++i) {
+        const ImageOperationCommand* command = dynamic_cast<const ImageOperationCommand*>(undoStack->command(i));
+        if (!command) continue;
+        for (const QImage& image : command->residentSnapshots()) {
+            if (!counted.contains(image.cacheKey())) {
+                counted.insert(image.cacheKey());
+                bytes += image.sizeInBytes();
+            }
+        }
+    }
+    ImageMemoryGovernor::instance()->reportUsage(undoMemoryConsumer, bytes);
+}
+
+qint64 ImageApplication::spillUndoSnapshots(qint64 bytesToFree) {
+    // Oldest first: those are the least likely to be undone to
+    qint64 released = 0;
+    for (int i = 0; i < undoStack->count() && released < bytesToFree; ++i) {
+        ImageOperationCommand* command = dynamic_cast<ImageOperationCommand*>(const_cast<QUndoCommand*>(undoStack->command(i)));
+        if (command) {
+            released += command->spillToDisk();
+        }
+    }
+    reportUndoUsage();
+    return released;
+}
+
 void ImageApplication::updateUIForImage() {
-    if (imageViewer && !imageViewer->currentImage().isNull()) {
+    if (imageViewer && imageViewer->hasImage()) {
         QFileInfo fileInfo(imageGallery->currentImagePath());
         if (!fileInfo.fileName().isEmpty()) {
             mainWindow->setWindowTitle("imageview - " + fileInfo.fileName());
@@ -808,33 +1425,33 @@ void ImageApplication::handleZoomOut() {
 
 void ImageApplication::handleRotateRight() {
     if (!imageViewer || imageViewer->getOriginalImage().isNull()) return; // Added check for image presence
-    ImageViewerState oldState = getCurrentImageViewerState();
+    ImageViewerState oldState = getCurrentImageViewerState(false);
     imageViewer->rotate(90);
-    ImageViewerState newState = getCurrentImageViewerState();
+    ImageViewerState newState = getCurrentImageViewerState(false);
     undoStack->push(new ImageTransformCommand(imageViewer, oldState, newState, "Rotate Right (90°)"));
 }
 
 void ImageApplication::handleRotateLeft() {
     if (!imageViewer || imageViewer->getOriginalImage().isNull()) return; // Added check for image presence
-    ImageViewerState oldState = getCurrentImageViewerState();
+    ImageViewerState oldState = getCurrentImageViewerState(false);
     imageViewer->rotate(-90);
-    ImageViewerState newState = getCurrentImageViewerState();
+    ImageViewerState newState = getCurrentImageViewerState(false);
     undoStack->push(new ImageTransformCommand(imageViewer, oldState, newState, "Rotate Left (-90°)"));
 }
 
 void ImageApplication::handleFlipHorizontal() {
     if (!imageViewer || imageViewer->getOriginalImage().isNull()) return; // Added check for image presence
-    ImageViewerState oldState = getCurrentImageViewerState();
+    ImageViewerState oldState = getCurrentImageViewerState(false);
     imageViewer->flipHorizontal();
-    ImageViewerState newState = getCurrentImageViewerState();
+    ImageViewerState newState = getCurrentImageViewerState(false);
     undoStack->push(new ImageTransformCommand(imageViewer, oldState, newState, "Flip Horizontal"));
 }
 
 void ImageApplication::handleFlipVertical() {
     if (!imageViewer || imageViewer->getOriginalImage().isNull()) return; // Added check for image presence
-    ImageViewerState oldState = getCurrentImageViewerState();
+    ImageViewerState oldState = getCurrentImageViewerState(false);
     imageViewer->flipVertical();
-    ImageViewerState newState = getCurrentImageViewerState();
+    ImageViewerState newState = getCurrentImageViewerState(false);
     undoStack->push(new ImageTransformCommand(imageViewer, oldState, newState, "Flip Vertical"));
 }
 
@@ -917,7 +1534,7 @@ void ImageApplication::handleAboutAction() {
         <ul>
             <li><b>Qt Core:</b> Fundamental non-GUI classes (event loop, signals & slots, I/O, threading).</li>
             <li><b>Qt GUI:</b> Base classes for graphical user interfaces (QImage, QPixmap, QPainter).</li>
-            <li><b>Qt Widgets:</b> Standard UI components (QMainWindow, QPushButton, QLabel, QListWidget).</li>
+            <li><b>Qt Widgets:</b> Standard UI components (QMainWindow, QPushButton, QLabel, QListView).</li>
             <li><b>Qt Multimedia:</b> For image reading/writing capabilities (QImageReader, QImageWriter, potentially QExifImageReader).</li>
             <li><b>Qt Concurrent:</b> For asynchronous operations like thumbnail generation (QtConcurrent::run).</li>
             <li><b>Qt PrintSupport:</b> For printing images to physical printers (QPrinter, QPrintDialog).</li>
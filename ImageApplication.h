@@ -17,11 +17,21 @@
 #include <QKeySequence>
 #include <QAction>
 #include <QUndoCommand> // For Undo/Redo commands
+#include <QHash>
+#include <QDateTime>
+#include <QImage>
+#include <QSharedPointer>
+#include <QTemporaryFile> // Undo snapshots spilled under memory pressure
+#include <functional>
+#include "ImageHeaderParser.h"
 
 // Forward declarations
 class ImageViewerWidget;
 class ImageGalleryWidget;
 class ImageDataManager;
+class DirectoryScanner;
+class DirectoryWatcher;
+class QLabel;
 
 // Define basic enums
 enum ZoomMode { FitToScreen, ActualSize, Custom };
@@ -52,10 +62,21 @@ public:
     ImageOperationCommand(ImageViewerWidget* viewer, const ImageViewerState& oldState, const ImageViewerState& newState, const QString& text);
     void undo() override;
     void redo() override;
+
+    // Snapshots still held in memory (for the memory governor's accounting)
+    QList<QImage> residentSnapshots() const;
+    // Moves both snapshots to temporary files; undo/redo read them back on demand.
+    // Returns the number of pixel bytes released.
+    qint64 spillToDisk();
 private:
+    static QSharedPointer<QTemporaryFile> writeSnapshot(const QImage& image);
+    static QImage readSnapshot(const QSharedPointer<QTemporaryFile>& file);
+
     ImageViewerWidget* m_viewer;
     ImageViewerState m_oldState;
     ImageViewerState m_newState;
+    QSharedPointer<QTemporaryFile> m_oldSpill; // Set once m_oldState.image was spilled
+    QSharedPointer<QTemporaryFile> m_newSpill;
 };
 
 // Specific Undo Commands (inheriting from ImageOperationCommand)
@@ -177,6 +198,15 @@ private slots:
     void handleNextImage();
     void handlePreviousImage();
     void handleThumbnailClicked(const QString& imagePath);
+    void handleImageLoaded(quint64 requestId, const QString& path, const QImage& image, const QSize& sourceSize);
+    void handleImagePartiallyLoaded(quint64 requestId, const QString& path, const QImage& image, const QSize& sourceSize);
+    void handleImageLoadFailed(quint64 requestId, const QString& path, const QString& errorString);
+    void handleFullResolutionRequested();
+    void handleHeadersReady(quint64 batchId, const QHash<QString, ImageHeaderInfo>& headers);
+    void handleDirectoryEntries(quint64 scanId, const QStringList& fileNames);
+    void handleDirectoryScanFinished(quint64 scanId, int count);
+    void handleDirectoryEntriesChanged(const QStringList& fileNames);
+    void handleDirectoryRescanNeeded();
     void handleAboutAction();
 
 private:
@@ -184,6 +214,8 @@ private:
     ImageViewerWidget* imageViewer;
     ImageGalleryWidget* imageGallery;
     ImageDataManager* imageDataManager;
+    DirectoryScanner* directoryScanner;
+    DirectoryWatcher* directoryWatcher;
     QUndoStack* undoStack;
     QSettings* settings;
 
@@ -215,11 +247,30 @@ private:
     QAction* normalAct;
     QAction* metadataAct;
     QAction* aboutAct;
+    QAction* sortByNameAct;
+    QAction* sortByDateAct;
+    QAction* sortBySizeAct;
+    QAction* thumbnailSmallAct;
+    QAction* thumbnailMediumAct;
+    QAction* thumbnailLargeAct;
 
     // Internal state
     QString currentDirectory;
     QVector<QString> imageList;
     int currentImageIndex;
+    quint64 pendingLoadRequest; // Id of the async load whose result should be displayed
+    quint64 fullResolutionRequest; // Id of the load upgrading the displayed preview, if any
+    QString displayedImagePath;
+    QHash<QString, ImageHeaderInfo> imageHeaders; // Header metadata of currentDirectory, keyed by full path
+    quint64 headerBatchRequest;
+    quint64 directoryScanRequest; // Scan filling imageList, 0 once currentDirectory is fully listed
+    QString pendingSelection;     // File opened before the listing reached it
+    QStringList deferredDirectoryChanges; // Changes seen while the listing was still running
+    QHash<QString, QDateTime> ownWrites; // Files we exported, with their mtime right after the write
+    QList<std::function<void()>> fullResolutionActions; // Run once the displayed preview is upgraded
+    int undoMemoryConsumer; // ImageMemoryGovernor id of the undo history
+    QLabel* memoryStatusLabel;
+    SortMode sortMode;
 
     // Helper functions
     void createActions();
@@ -227,9 +278,23 @@ private:
     void createToolbars();
     void connectSignalsAndSlots();
     void updateUIForImage();
+    void reportUndoUsage();
+    qint64 spillUndoSnapshots(qint64 bytesToFree);
+    void prefetchNeighbors(); // Warm the decoded-image cache around currentImageIndex
+    void startDirectoryScan(const QString& directory, const QString& selection); // Resets the list and gallery
+    void applyDirectoryChanges(const QStringList& fileNames); // Incremental update of imageList and the gallery
+    void clearDisplayedImage(); // Nothing left to show: empty viewer, no pending loads, no undo history
+    QSize viewportDecodeSize() const; // Target size for "decode for viewport", invalid for full resolution
+    void requestFullResolution();
+    // Editing and exporting need the real pixels, not the screen-sized preview. Returns
+    // false when the displayed image is full resolution; otherwise action is queued
+    // until the upgrade lands (or refused for images too large to hold) and true is returned.
+    bool deferUntilFullResolution(const std::function<void()>& action);
+    void runFullResolutionActions();
 
     // Helper to get current ImageViewerWidget state
-    ImageViewerState getCurrentImageViewerState() const;
+    // Without the image for view-only operations (rotate, flip): their undo keeps the current pixels
+    ImageViewerState getCurrentImageViewerState(bool withImage = true) const;
 };
 
 #endif // IMAGEAPPLICATION_H
\ No newline at end of file
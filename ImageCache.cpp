@@ -0,0 +1,86 @@
+#include "ImageCache.h"
+#include <iterator>
+
+ImageCache::ImageCache(qint64 maxBytes)
+    : m_maxBytes(maxBytes), m_bytes(0), m_hits(0), m_misses(0), m_evictions(0) {}
+
+void ImageCache::setMaxBytes(qint64 maxBytes) {
+    m_maxBytes = qMax<qint64>(0, maxBytes);
+    evictToFit(m_maxBytes);
+}
+
+QImage ImageCache::find(const QString& key) {
+    auto it = m_index.find(key);
+    if (it == m_index.end()) {
+        ++m_misses;
+        return QImage();
+    }
+    ++m_hits;
+    // Move the entry to the front without copying it
+    m_entries.splice(m_entries.begin(), m_entries, it.value());
+    return m_entries.front().image;
+}
+
+bool ImageCache::contains(const QString& key) const {
+    return m_index.contains(key);
+}
+
+void ImageCache::insert(const QString& key, const QImage& image) {
+    if (image.isNull()) return;
+    remove(key);
+
+    const qint64 bytes = image.sizeInBytes();
+    if (bytes > m_maxBytes) {
+        return; // Would evict everything else and still not fit
+    }
+    evictToFit(m_maxBytes - bytes);
+    m_entries.push_front(Entry{key, image, bytes});
+    m_index.insert(key, m_entries.begin());
+    m_bytes += bytes;
+}
+
+void ImageCache::remove(const QString& key) {
+    auto it = m_index.find(key);
+    if (it == m_index.end()) return;
+    m_bytes -= it.value()->bytes;
+    m_entries.erase(it.value());
+    m_index.erase(it);
+}
+
+void ImageCache::clear() {
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+}
+
+qint64 ImageCache::evict(qint64 bytesToFree) {
+    const qint64 before = m_bytes;
+    evictToFit(qMax<qint64>(0, m_bytes - bytesToFree));
+    return before - m_bytes;
+}
+
+ImageCacheStats ImageCache::stats() const {
+    ImageCacheStats s;
+    s.hits = m_hits;
+    s.misses = m_misses;
+    s.evictions = m_evictions;
+    s.bytes = m_bytes;
+    s.maxBytes = m_maxBytes;
+    s.entries = m_index.size();
+    return s;
+}
+
+void ImageCache::evictToFit(qint64 budget) {
+    while (m_bytes > budget && !m_entries.empty()) {
+        if (!m_pinnedKey.isEmpty() && m_entries.back().key == m_pinnedKey) {
+            if (m_entries.size() == 1) break;
+            m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+            continue;
+        }
+        const Entry& victim = m_entries.back();
+        m_bytes -= victim.bytes;
+        m_index.remove(victim.key);
+        m_entries.pop_back();
+        ++m_evictions;
+    }
+}
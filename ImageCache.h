@@ -0,0 +1,60 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QString>
+#include <list>
+
+// Counters used to size the cache budget from real navigation patterns
+struct ImageCacheStats {
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 evictions = 0;
+    qint64 bytes = 0;     // Bytes currently held
+    qint64 maxBytes = 0;  // Configured budget
+    int entries = 0;
+};
+
+// Least-recently-used cache of decoded images, bounded by the total number of
+// pixel bytes it holds rather than by entry count (one 50 MP TIFF weighs as much
+// as a hundred phone snapshots). Not thread-safe: owned and used on the GUI thread.
+class ImageCache {
+public:
+    explicit ImageCache(qint64 maxBytes = 512LL * 1024 * 1024);
+
+    void setMaxBytes(qint64 maxBytes);
+    qint64 maxBytes() const { return m_maxBytes; }
+
+    QImage find(const QString& key);          // Counts a hit or miss and refreshes recency
+    bool contains(const QString& key) const;  // Plain lookup, leaves counters and recency alone
+    void insert(const QString& key, const QImage& image);
+    void remove(const QString& key);
+    void clear();
+    qint64 evict(qint64 bytesToFree); // Drops least recently used entries, returns the bytes released
+    // The pinned entry (e.g. the image on screen) is never evicted, however old it gets:
+    // a burst of prefetches must not push out what the user is looking at
+    void setPinned(const QString& key) { m_pinnedKey = key; }
+
+    ImageCacheStats stats() const;
+
+private:
+    struct Entry {
+        QString key;
+        QImage image;
+        qint64 bytes;
+    };
+
+    void evictToFit(qint64 budget);
+
+    std::list<Entry> m_entries; // Front is the most recently used entry
+    QHash<QString, std::list<Entry>::iterator> m_index;
+    QString m_pinnedKey;
+    qint64 m_maxBytes;
+    qint64 m_bytes;
+    quint64 m_hits;
+    quint64 m_misses;
+    quint64 m_evictions;
+};
+
+#endif // IMAGECACHE_H
@@ -5,28 +5,336 @@
 #include <QDateTime> // For file modification time metadata
 #include <QFileInfo> // For file info
 #include <QLocale>   // For QLocale::system().toString() to replace deprecated Qt::SystemLocaleLongDate
+#include <QMetaObject>
+#include <QtConcurrent> // For header batches
+#include "MappedFile.h"
+#include "TiledImageSource.h"
+#include "ImageMemoryGovernor.h"
 
-ImageDataManager::ImageDataManager(QObject* parent) : QObject(parent) {
-    // Constructor logic
+namespace {
+// Below this a full decode is quick enough that intermediate stages only add work
+const qint64 kProgressiveMinFileBytes = 1024 * 1024;
+}
+
+ImageDataManager::ImageDataManager(QObject* parent)
+    : QObject(parent), m_generation(0), m_prefetchGeneration(0), m_progressiveLoading(true), m_memoryConsumer(0), m_headerWatcher(nullptr), m_headerBatch(0) {
+    // The cache is the first thing given up when the global image budget is exceeded
+    m_memoryConsumer = ImageMemoryGovernor::instance()->registerConsumer(
+        ImageMemoryGovernor::PrefetchCache, "Decoded image cache", [this](qint64 bytesToFree) {
+            const qint64 released = m_imageCache.evict(bytesToFree);
+            reportCacheUsage();
+            return released;
+        });
+}
+
+ImageDataManager::~ImageDataManager() {
+    cancelPendingLoads();
+    m_prefetchGeneration.fetchAndAddOrdered(1);
+    // Workers reference this object, wait for them before members go away
+    DecodeScheduler::instance()->cancelOwner(this);
+    DecodeScheduler::instance()->waitForOwner(this);
+    if (m_headerWatcher) {
+        m_headerWatcher->cancel();
+        m_headerWatcher->waitForFinished();
+    }
+    ImageMemoryGovernor::instance()->unregisterConsumer(m_memoryConsumer);
+}
+
+void ImageDataManager::reportCacheUsage() {
+    ImageMemoryGovernor::instance()->reportUsage(m_memoryConsumer, m_imageCache.stats().bytes);
+}
+
+QString ImageDataManager::cacheKey(const QString& path) const {
+    // Include the modification time so an edited file is never served stale. Header
+    // batches already read it on a worker; only unknown files are stat'ed here.
+    const QFileInfo fileInfo(path);
+    const QString absolutePath = fileInfo.absoluteFilePath();
+    auto known = m_modificationTimes.constFind(absolutePath);
+    const qint64 modified = known != m_modificationTimes.constEnd() ? known.value() : fileInfo.lastModified().toMSecsSinceEpoch();
+    return absolutePath + QLatin1Char('|') + QString::number(modified);
+}
+
+void ImageDataManager::forgetModificationTimes(const QStringList& paths) {
+    for (const QString& path : paths) {
+        m_modificationTimes.remove(QFileInfo(path).absoluteFilePath());
+    }
+}
+
+QSize ImageDataManager::decodeBucket(const QSize& targetSize) {
+    if (!targetSize.isValid() || targetSize.isEmpty()) {
+        return QSize(); // Full resolution
+    }
+    // Round up to 256 px steps so small window or screen changes still hit the cache
+    auto roundUp = [](int value) { return ((value + 255) / 256) * 256; };
+    return QSize(roundUp(targetSize.width()), roundUp(targetSize.height()));
+}
+
+QString ImageDataManager::lookupKey(const QString& path, const QSize& bucket) const {
+    const QString fullKey = cacheKey(path);
+    if (!bucket.isValid() || m_imageCache.contains(fullKey)) {
+        return fullKey; // A full-resolution decode beats any reduced one
+    }
+    return fullKey + QLatin1Char('|') + QString::number(bucket.width()) + QLatin1Char('x') + QString::number(bucket.height());
+}
+
+QImage ImageDataManager::decodeImage(const QString& path, const QSize& targetSize, QSize* sourceSize, QString* errorString,
+                                     const std::function<bool()>& isCancelled) {
+    QSharedPointer<MappedFile> file = MappedFile::open(path, errorString);
+    if (!file) {
+        return QImage();
+    }
+    file->adviseSequential();
+    MappedFileDevice device(file);
+    device.setCancelCheck(isCancelled);
+
+    QImageReader reader(&device);
+    if (!reader.canRead()) {
+        if (errorString) *errorString = "Unsupported format or file does not exist";
+        return QImage();
+    }
+
+    const QSize nativeSize = reader.size();
+    if (TiledImageSource::shouldUseTiles(nativeSize)) {
+        // Too big to hold whole: build the overview band by band. The viewer then
+        // renders deeper zoom levels from tiles instead of a full-resolution decode.
+        if (QSharedPointer<TiledImageSource> tiled = TiledImageSource::open(path)) {
+            if (sourceSize) *sourceSize = nativeSize;
+            QImage overview = tiled->overview(targetSize.isValid() ? targetSize : QSize(4096, 4096));
+            if (overview.isNull() && errorString) *errorString = "Failed to decode image overview";
+            return overview;
+        }
+    }
+    if (targetSize.isValid() && nativeSize.isValid()
+        && (nativeSize.width() > targetSize.width() || nativeSize.height() > targetSize.height())) {
+        // Handlers supporting ScaledSize decode straight to the smaller size (the JPEG
+        // handler uses libjpeg's DCT-domain scaling). For the others QImageReader scales
+        // after decoding, which still keeps only the small copy alive.
+        reader.setScaledSize(nativeSize.scaled(targetSize, Qt::KeepAspectRatio));
+    }
+
+    QImage image = reader.read();
+    if (device.wasCancelled()) {
+        image = QImage(); // Partially decoded, never hand it out
+    }
+    if (image.isNull() && errorString) {
+        *errorString = device.wasCancelled() ? QStringLiteral("Decode cancelled") : reader.errorString();
+    }
+    if (sourceSize) {
+        *sourceSize = nativeSize.isValid() ? nativeSize : image.size();
+    }
+    return image;
+}
+
+void ImageDataManager::decodeProgressiveStages(const QString& path, const QSize& targetSize,
+                                               const std::function<void(const QImage&, const QSize&)>& deliver,
+                                               const std::function<bool()>& isCancelled) {
+    QSharedPointer<MappedFile> file = MappedFile::open(path); // Shared with the final decode
+    if (!file || file->size() < kProgressiveMinFileBytes) {
+        return;
+    }
+
+    // Stage 1: the EXIF thumbnail sits in the first few KB, so it shows up even on slow storage
+    const ImageHeaderInfo header = ImageHeaderParser::parse(file->data(), file->size());
+    QSize nativeSize = header.size;
+    int shownWidth = 0;
+    if (header.thumbnailLength > 0 && header.thumbnailOffset + header.thumbnailLength <= file->size()) {
+        QImage thumbnail = QImage::fromData(file->data() + header.thumbnailOffset, int(header.thumbnailLength));
+        if (!thumbnail.isNull()) {
+            if (!nativeSize.isValid()) nativeSize = thumbnail.size();
+            deliver(thumbnail, nativeSize);
+            shownWidth = thumbnail.width();
+        }
+    }
+    if (isCancelled && isCancelled()) return;
+
+    // Stage 2: a 1/8 scaled decode. For JPEG this is libjpeg's DCT scaling, which skips
+    // most of the IDCT and colour conversion work, but the whole file is still read and
+    // entropy decoded, and the final decode waits for it. A baseline JPEG's final decode is
+    // DCT scaled as well and barely slower, so only progressive JPEGs, whose final decode
+    // makes several passes over buffered coefficients, get a coarse stage.
+    if (header.format == QLatin1String("JPEG") && !header.progressive) return;
+    MappedFileDevice device(file);
+    device.setCancelCheck(isCancelled);
+    QImageReader reader(&device);
+    if (!reader.canRead() || !reader.supportsOption(QImageIOHandler::ScaledSize)) {
+        return; // Without DCT scaling a coarse decode costs as much as the real one
+    }
+    if (!nativeSize.isValid()) nativeSize = reader.size();
+    if (!nativeSize.isValid()) return;
+    const QSize coarseSize((nativeSize.width() + 7) / 8, (nativeSize.height() + 7) / 8);
+    const int finalWidth = targetSize.isValid()
+        ? nativeSize.scaled(targetSize, Qt::KeepAspectRatio).width() : nativeSize.width();
+    if (coarseSize.width() <= shownWidth * 3 / 2 || coarseSize.width() * 2 > finalWidth) {
+        return; // Not noticeably sharper than the thumbnail, or not much cheaper than the final decode
+    }
+    reader.setScaledSize(coarseSize);
+    QImage coarse = reader.read();
+    if (!coarse.isNull() && !device.wasCancelled()) {
+        deliver(coarse, nativeSize);
+    }
 }
 
 QImage ImageDataManager::loadImage(const QString& path) {
-    QImageReader reader(path);
-    if (reader.canRead()) {
-        QImage image = reader.read();
-        if (image.isNull()) {
-            qDebug() << "Failed to read image:" << path << reader.errorString();
-        } else {
-            // Emit signal (though imageViewer is typically connected directly in ImageApplication)
-            // emit imageLoaded(image); // This signal can be used if ImageDataManager needs to notify multiple listeners
+    QString error;
+    QImage image = decodeImage(path, QSize(), nullptr, &error);
+    if (image.isNull()) {
+        qDebug() << "Failed to read image:" << path << error;
+    }
+    // Emit signal (though imageViewer is typically connected directly in ImageApplication)
+    // emit imageLoaded(image); // This signal can be used if ImageDataManager needs to notify multiple listeners
+    return image;
+}
+
+quint64 ImageDataManager::loadImageAsync(const QString& path, const QSize& targetSize) {
+    const quint64 requestId = m_generation.fetchAndAddOrdered(1) + 1;
+    const QSize bucket = decodeBucket(targetSize);
+    const QString key = lookupKey(path, bucket);
+    m_pendingKey = key;
+    m_pendingPath = path;
+    m_pendingBucket = bucket;
+
+    QImage cached = m_imageCache.find(key);
+    if (!cached.isNull()) {
+        // Deliver through the event loop so callers always see the request id before the result
+        QMetaObject::invokeMethod(this, [this, key, requestId, cached]() {
+            if (isCurrentRequest(requestId) && m_pendingKey == key) {
+                deliverPending(cached, QString());
+            }
+        }, Qt::QueuedConnection);
+        return requestId;
+    }
+
+    if (m_prefetchInFlight.contains(key)) {
+        // A neighbor prefetch is already decoding this image; handlePrefetchResult() picks it up
+        return requestId;
+    }
+
+    startForegroundDecode(path, key, bucket, requestId);
+    return requestId;
+}
+
+void ImageDataManager::startForegroundDecode(const QString& path, const QString& key, const QSize& bucket, quint64 requestId) {
+    // Stages only help when a viewport-sized image is wanted; a full-resolution
+    // request already has the preview on screen.
+    const bool progressive = m_progressiveLoading && bucket.isValid();
+    DecodeScheduler::Job job;
+    job.priority = DecodeScheduler::VisibleImage;
+    job.path = path;
+    job.owner = this;
+    // Skip decodes that were superseded while waiting in the queue (e.g. holding Page Down)
+    job.isStale = [this, requestId]() { return !isCurrentRequest(requestId); };
+    job.run = [this, path, key, bucket, requestId, progressive](const QSharedPointer<MappedFile>&) {
+        auto isCancelled = [this, requestId]() { return !isCurrentRequest(requestId); };
+        if (progressive) {
+            decodeProgressiveStages(path, bucket, [this, path, key, requestId](const QImage& partial, const QSize& sourceSize) {
+                QMetaObject::invokeMethod(this, [this, path, key, requestId, partial, sourceSize]() {
+                    if (isCurrentRequest(requestId) && m_pendingKey == key) {
+                        emit imagePartiallyLoaded(requestId, path, partial, sourceSize);
+                    }
+                }, Qt::QueuedConnection);
+            }, isCancelled);
+        }
+        QString error;
+        QSize sourceSize;
+        QImage image = decodeImage(path, bucket, &sourceSize, &error, isCancelled);
+        // Deliver on the GUI thread; the generation is checked there because a newer
+        // request may have been issued meanwhile. The image is cached either way,
+        // since flipping back to it is the common case.
+        QMetaObject::invokeMethod(this, [this, key, requestId, image, sourceSize, error]() {
+            storeDecoded(key, image, sourceSize);
+            if (isCurrentRequest(requestId) && m_pendingKey == key) {
+                deliverPending(image, error);
+            }
+        }, Qt::QueuedConnection);
+    };
+    DecodeScheduler::instance()->schedule(job);
+}
+
+void ImageDataManager::storeDecoded(const QString& key, const QImage& image, const QSize& sourceSize) {
+    if (image.isNull()) return;
+    m_imageCache.insert(key, image);
+    m_sourceSizes.insert(key, sourceSize);
+    reportCacheUsage();
+
+    // Forget sizes of decodes the cache has long evicted
+    if (m_sourceSizes.size() > 2 * m_imageCache.stats().entries + 64) {
+        for (auto it = m_sourceSizes.begin(); it != m_sourceSizes.end();) {
+            it = m_imageCache.contains(it.key()) ? it + 1 : m_sourceSizes.erase(it);
         }
-        return image;
+    }
+}
+
+void ImageDataManager::deliverPending(const QImage& image, const QString& errorString) {
+    const quint64 requestId = m_generation.loadAcquire();
+    const QString path = m_pendingPath;
+    const QSize sourceSize = m_sourceSizes.value(m_pendingKey, image.size());
+    m_imageCache.setPinned(m_pendingKey); // On screen from now on
+    m_pendingKey.clear(); // Delivered, a second decode of the same key must not emit again
+    m_pendingPath.clear();
+    if (image.isNull()) {
+        qDebug() << "Failed to read image:" << path << errorString;
+        emit imageLoadFailed(requestId, path, errorString);
     } else {
-        qDebug() << "Cannot read image file (unsupported format or does not exist):" << path;
-        return QImage();
+        emit imageLoadFinished(requestId, path, image, sourceSize);
+    }
+}
+
+void ImageDataManager::prefetchImages(const QStringList& paths, const QSize& targetSize) {
+    const quint64 batch = m_prefetchGeneration.fetchAndAddOrdered(1) + 1;
+    const QSize bucket = decodeBucket(targetSize);
+    for (const QString& path : paths) {
+        const QString key = lookupKey(path, bucket);
+        if (m_imageCache.contains(key) || m_prefetchInFlight.contains(key)) {
+            continue;
+        }
+        m_prefetchInFlight.insert(key);
+        DecodeScheduler::Job job;
+        job.priority = DecodeScheduler::NeighborPrefetch;
+        job.path = path;
+        job.owner = this;
+        // A newer navigation replaced this batch before the decode started
+        job.isStale = [this, batch]() { return m_prefetchGeneration.loadAcquire() != batch; };
+        job.dropped = [this, path, key]() {
+            QMetaObject::invokeMethod(this, [this, path, key]() {
+                handlePrefetchResult(path, key, QImage(), QSize(), true);
+            }, Qt::QueuedConnection);
+        };
+        job.run = [this, path, key, bucket](const QSharedPointer<MappedFile>&) {
+            // Not cancellable mid-decode: the current request may be parked on this result
+            QSize sourceSize;
+            QImage image = decodeImage(path, bucket, &sourceSize, nullptr);
+            QMetaObject::invokeMethod(this, [this, path, key, image, sourceSize]() {
+                handlePrefetchResult(path, key, image, sourceSize, false);
+            }, Qt::QueuedConnection);
+        };
+        DecodeScheduler::instance()->schedule(job);
+    }
+}
+
+void ImageDataManager::handlePrefetchResult(const QString& path, const QString& key, const QImage& image,
+                                            const QSize& sourceSize, bool skipped) {
+    m_prefetchInFlight.remove(key);
+    storeDecoded(key, image, sourceSize);
+
+    if (m_pendingKey != key) return; // Nobody is waiting for this image right now
+    if (!image.isNull()) {
+        deliverPending(image, QString());
+    } else if (skipped) {
+        // The current request was parked on this prefetch, decode it for real now
+        startForegroundDecode(path, key, m_pendingBucket, m_generation.loadAcquire());
+    } else {
+        deliverPending(image, "Failed to decode image");
     }
 }
 
+void ImageDataManager::cancelPendingLoads() {
+    // Bumping the generation invalidates every outstanding request id
+    m_generation.fetchAndAddOrdered(1);
+    m_pendingKey.clear();
+    m_pendingPath.clear();
+    m_pendingBucket = QSize();
+}
+
 QMap<QString, QString> ImageDataManager::getImageMetadata(const QString& path) {
     QMap<QString, QString> metadata;
     QFile file(path);
@@ -45,52 +353,82 @@ QMap<QString, QString> ImageDataManager::getImageMetadata(const QString& path) {
     metadata["Created"] = QLocale::system().toString(fileInfo.birthTime(), QLocale::LongFormat);
     metadata["Format"] = fileInfo.suffix().toUpper();
 
-    QImageReader reader(path);
-    if (reader.canRead()) {
-        metadata["Dimensions"] = QString::number(reader.size().width()) + " x " + QString::number(reader.size().height()) + " pixels";
-        // REMOVED THE LINE THAT CAUSED THE ERROR: metadata["Depth"] = QString::number(reader.imageFormat().depth()) + " bits";
-        // QImageReader::imageFormat() returns an enum, not a class with a depth() method.
-        // To get depth, you'd typically need to load the image first (QImage::depth()).
-    }
-
-// The following block for QExifImageReader is commented out as requested.
-// #ifdef QT_MULTIMEDIA_LIB
-//     // --- EXIF Metadata (requires QtMultimedia module) ---
-//     QExifImageReader exifReader(path);
-//     if (exifReader.canRead()) {
-//         QImageMetaData exifData = exifReader.imageMetaData();
-//         if (exifData.contains(QImageMetaData::Orientation)) {
-//             metadata["Orientation"] = QString::number(exifData.value(QImageMetaData::Orientation).toInt());
-//         }
-//         if (exifData.contains(QImageMetaData::DateTimeOriginal)) {
-//             metadata["Date Taken"] = exifData.value(QImageMetaData::DateTimeOriginal).toDateTime().toString(Qt::SystemLocaleLongDate);
-//         }
-//         if (exifData.contains(QImageMetaData::Make)) {
-//             metadata["Camera Make"] = exifData.value(QImageMetaData::Make).toString();
-//         }
-//         if (exifData.contains(QImageMetaData::Model)) {
-//             metadata["Camera Model"] = exifData.value(QImageMetaData::Model).toString();
-//         }
-//         if (exifData.contains(QImageMetaData::ExposureTime)) {
-//             metadata["Exposure Time"] = exifData.value(QImageMetaData::ExposureTime).toString();
-//         }
-//         if (exifData.contains(QImageMetaData::FNumber)) {
-//             metadata["F-Number"] = QString::number(exifData.value(QImageMetaData::FNumber).toFloat(), 'f', 1);
-//         }
-//         if (exifData.contains(QImageMetaData::ISOSpeedRatings)) {
-//             metadata["ISO Speed"] = QString::number(exifData.value(QImageMetaData::ISOSpeedRatings).toInt());
-//         }
-//         if (exifData.contains(QImageMetaData::FocalLength)) {
-//             metadata["Focal Length"] = QString::number(exifData.value(QImageMetaData::FocalLength).toFloat(), 'f', 1) + " mm";
-//         }
-//         // Add more EXIF tags as needed
-//     } else {
-//         qDebug() << "QExifImageReader cannot read EXIF for:" << path << (exifReader.error() == QExifImageReader::UnsupportedFormatError ? " (Unsupported format)" : "");
-//     }
-// #else
-//     qDebug() << "QtMultimedia module not available for full EXIF support.";
-// #endif
+    // --- Header and EXIF Metadata (no pixels are decoded) ---
+    const ImageHeaderInfo header = ImageHeaderParser::parseFile(path);
+    QSize dimensions = header.size;
+    if (!dimensions.isValid()) {
+        // BMP, GIF, ...: let the image handler read its own header through the shared mapping
+        QSharedPointer<MappedFile> mapped = MappedFile::open(path);
+        MappedFileDevice device(mapped);
+        QImageReader reader(&device);
+        if (mapped && reader.canRead()) {
+            dimensions = reader.size();
+        }
+    }
+    if (dimensions.isValid()) {
+        metadata["Dimensions"] = QString::number(dimensions.width()) + " x " + QString::number(dimensions.height()) + " pixels";
+    }
+    if (header.orientation > 0) {
+        metadata["Orientation"] = QString::number(header.orientation);
+    }
+    if (header.captureTime.isValid()) {
+        metadata["Date Taken"] = QLocale::system().toString(header.captureTime, QLocale::LongFormat);
+    }
+    if (!header.cameraMake.isEmpty()) {
+        metadata["Camera Make"] = header.cameraMake;
+    }
+    if (!header.cameraModel.isEmpty()) {
+        metadata["Camera Model"] = header.cameraModel;
+    }
+    if (header.exposureTime > 0) {
+        metadata["Exposure Time"] = header.exposureTime < 1.0
+            ? "1/" + QString::number(qRound(1.0 / header.exposureTime)) + " s"
+            : QString::number(header.exposureTime, 'g', 3) + " s";
+    }
+    if (header.fNumber > 0) {
+        metadata["F-Number"] = QString::number(header.fNumber, 'f', 1);
+    }
+    if (header.isoSpeed > 0) {
+        metadata["ISO Speed"] = QString::number(header.isoSpeed);
+    }
+    if (header.focalLength > 0) {
+        metadata["Focal Length"] = QString::number(header.focalLength, 'f', 1) + " mm";
+    }
 
     emit metadataReady(metadata);
     return metadata;
-}
\ No newline at end of file
+}
+
+quint64 ImageDataManager::readHeadersAsync(const QStringList& paths) {
+    if (m_headerWatcher) {
+        // A newer directory replaces the batch; its partial results are not wanted
+        m_headerWatcher->disconnect(this);
+        m_headerWatcher->cancel();
+        if (m_headerWatcher->isFinished()) {
+            m_headerWatcher->deleteLater();
+        } else {
+            connect(m_headerWatcher, &QFutureWatcherBase::finished, m_headerWatcher, &QObject::deleteLater);
+        }
+    }
+    const quint64 batchId = ++m_headerBatch;
+
+    // Header parsing is I/O bound and tiny per file; spread it over the worker pool
+    m_headerWatcher = new QFutureWatcher<ImageHeaderInfo>(this);
+    QFutureWatcher<ImageHeaderInfo>* watcher = m_headerWatcher;
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, batchId]() {
+        QHash<QString, ImageHeaderInfo> headers;
+        const QList<ImageHeaderInfo> results = watcher->future().results();
+        headers.reserve(results.size());
+        for (const ImageHeaderInfo& info : results) {
+            headers.insert(info.path, info);
+            if (info.lastModified.isValid()) {
+                m_modificationTimes.insert(QFileInfo(info.path).absoluteFilePath(), info.lastModified.toMSecsSinceEpoch());
+            }
+        }
+        if (m_headerWatcher == watcher) m_headerWatcher = nullptr;
+        watcher->deleteLater();
+        emit headersReady(batchId, headers);
+    });
+    watcher->setFuture(QtConcurrent::mapped(paths, &ImageHeaderParser::parseFile));
+    return batchId;
+}
@@ -6,22 +6,97 @@
 #include <QMap>
 #include <QString>
 #include <QImageReader> // For QImageReader
-
-// For EXIF metadata - Temporarily commented out due to "No such file or directory" error
-// #ifdef QT_MULTIMEDIA_LIB
-// #include <QExifImageReader> // Qt5 and newer
-// #endif
+#include <QAtomicInteger>
+#include <QSet>
+#include <QStringList>
+#include <QHash>
+#include <QSize>
+#include <QFutureWatcher>
+#include <functional>
+#include "ImageCache.h"
+#include "DecodeScheduler.h" // Decodes run as VisibleImage / NeighborPrefetch jobs
+#include "ImageHeaderParser.h" // EXIF and dimensions without decoding pixels
 
 class ImageDataManager : public QObject {
     Q_OBJECT
 public:
     ImageDataManager(QObject* parent = nullptr);
+    ~ImageDataManager();
+
     QImage loadImage(const QString& path);
+
+    // Asynchronous loading: decodes on a worker thread and reports through
+    // imageLoadFinished/imageLoadFailed. The returned request id doubles as a
+    // generation token: every new request supersedes all older ones, so stale
+    // decodes are skipped before they start and their results are dropped.
+    // With a valid targetSize the image is decoded to fit it ("decode for viewport");
+    // the native size is still reported so the viewer can zoom in true pixels.
+    quint64 loadImageAsync(const QString& path, const QSize& targetSize = QSize());
+    void cancelPendingLoads();
+    bool isCurrentRequest(quint64 requestId) const { return requestId == m_generation.loadAcquire(); }
+
+    // Speculatively decode the given paths into the decoded-image cache. Each call
+    // supersedes the previous prefetch batch; decodes that have not started yet are skipped.
+    void prefetchImages(const QStringList& paths, const QSize& targetSize = QSize());
+
+    // Progressive display: before the final decode of a large file, emit quick
+    // low-resolution stages (embedded EXIF thumbnail, then a 1/8 DCT-scaled JPEG
+    // decode) through imagePartiallyLoaded so the viewer is never blank for long.
+    void setProgressiveLoading(bool enabled) { m_progressiveLoading = enabled; }
+
+    void setCacheLimit(qint64 maxBytes) { m_imageCache.setMaxBytes(maxBytes); reportCacheUsage(); }
+    ImageCacheStats cacheStats() const { return m_imageCache.stats(); }
+
     QMap<QString, QString> getImageMetadata(const QString& path);
 
+    // Parses the headers of all paths on worker threads and reports them in one
+    // headersReady() batch. A new batch cancels the previous one.
+    quint64 readHeadersAsync(const QStringList& paths);
+    // Cache keys include the file's modification time, taken from header batches when
+    // known. Files changed on disk must be forgotten until their headers are read again.
+    void forgetModificationTimes(const QStringList& paths);
+    void clearModificationTimes() { m_modificationTimes.clear(); }
+
 signals:
     void imageLoaded(const QImage& image);
+    void imageLoadFinished(quint64 requestId, const QString& path, const QImage& image, const QSize& sourceSize);
+    void imagePartiallyLoaded(quint64 requestId, const QString& path, const QImage& image, const QSize& sourceSize);
+    void imageLoadFailed(quint64 requestId, const QString& path, const QString& errorString);
     void metadataReady(const QMap<QString, QString>& metadata);
+    void headersReady(quint64 batchId, const QHash<QString, ImageHeaderInfo>& headers);
+
+private:
+    static QImage decodeImage(const QString& path, const QSize& targetSize, QSize* sourceSize, QString* errorString,
+                              const std::function<bool()>& isCancelled = std::function<bool()>());
+    static void decodeProgressiveStages(const QString& path, const QSize& targetSize,
+                                        const std::function<void(const QImage&, const QSize&)>& deliver,
+                                        const std::function<bool()>& isCancelled);
+    QString cacheKey(const QString& path) const;
+    static QSize decodeBucket(const QSize& targetSize);
+    QString lookupKey(const QString& path, const QSize& bucket) const;
+
+    void startForegroundDecode(const QString& path, const QString& key, const QSize& bucket, quint64 requestId);
+    void reportCacheUsage();
+    void storeDecoded(const QString& key, const QImage& image, const QSize& sourceSize);
+    void deliverPending(const QImage& image, const QString& errorString);
+    void handlePrefetchResult(const QString& path, const QString& key, const QImage& image, const QSize& sourceSize, bool skipped);
+
+    QAtomicInteger<quint64> m_generation;         // Id of the most recent load request
+    QAtomicInteger<quint64> m_prefetchGeneration; // Id of the most recent prefetch batch
+
+    // GUI-thread state
+    ImageCache m_imageCache;        // Decoded images keyed by path, modification time and decode size
+    QHash<QString, QSize> m_sourceSizes; // Native size for each cached decode
+    QHash<QString, qint64> m_modificationTimes; // Msecs since epoch by absolute path, from header batches
+    QSet<QString> m_prefetchInFlight;
+    QString m_pendingKey;           // Cache key the current load request is still waiting for
+    QString m_pendingPath;
+    QSize m_pendingBucket;
+    bool m_progressiveLoading;
+    int m_memoryConsumer; // ImageMemoryGovernor id of m_imageCache
+
+    QFutureWatcher<ImageHeaderInfo>* m_headerWatcher;
+    quint64 m_headerBatch;
 };
 
 #endif // IMAGEDATAMANAGER_H
\ No newline at end of file
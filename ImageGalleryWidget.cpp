@@ -1,88 +1,368 @@
 #include "ImageGalleryWidget.h"
 #include <QDir>
-#include <QListWidgetItem>
 #include <QDebug>
 #include <QImage>
-#include <QPixmap>
-#include <QFuture>
-#include <QtConcurrent> // For asynchronous thumbnail generation
+#include <QPainter>
+#include <QStyle>
+#include <QApplication>
 #include <QMetaObject>  // For QMetaObject::invokeMethod
 #include <QFileInfo>    // For QFileInfo to get filename
+#include "GalleryModel.h"
+#include "MappedFile.h"
+#include "ImageMemoryGovernor.h"
+#include "ThumbnailGenerator.h"
+#include "ThumbnailCache.h"
+#include <QScrollBar>
+#include <QWindow>
 
-ImageGalleryWidget::ImageGalleryWidget(QWidget* parent) : QListWidget(parent) {
-    connect(this, &QListWidget::itemClicked, this, &ImageGalleryWidget::onItemClicked);
+namespace {
+// Rows kept ready beyond the viewport, so slow scrolling never shows blank icons
+const int kMinPrefetchRows = 8;
+const int kItemMargin = 4;
+// Finished thumbnails are handed to the view at most this often (one 60 Hz frame)
+const int kDeliveryIntervalMs = 16;
+}
+
+void GalleryDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    // Background and selection highlight only. No initStyleOption(): it would fetch
+    // DecorationRole, a per-paint copy of the thumbnail. Icon and text are drawn below.
+    const QWidget* widget = option.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+    style->drawControl(QStyle::CE_ItemViewItem, &option, painter, widget);
+
+    const QRect contents = option.rect.adjusted(kItemMargin, kItemMargin, -kItemMargin, -kItemMargin);
+    const QRect iconRect(contents.left() + (contents.width() - m_iconSize.width()) / 2, contents.top(),
+                         m_iconSize.width(), m_iconSize.height());
+    // Straight from the atlas page: no per-row pixmap, no QVariant copy
+    const GalleryModel* model = qobject_cast<const GalleryModel*>(index.model());
+    const int slot = model ? model->thumbnailSlot(index.row()) : -1;
+    if (slot >= 0) {
+        model->thumbnails().draw(painter, iconRect, slot, m_devicePixelRatio);
+    } else {
+        painter->save();
+        painter->setPen(option.palette.color(QPalette::Mid));
+        painter->drawRect(iconRect.adjusted(0, 0, -1, -1)); // Placeholder until the thumbnail arrives
+        painter->restore();
+    }
+
+    const QRect textRect(contents.left(), iconRect.bottom() + 1, contents.width(), option.fontMetrics.height());
+    const QString name = option.fontMetrics.elidedText(index.data(Qt::DisplayRole).toString(), Qt::ElideMiddle, textRect.width());
+    painter->save();
+    painter->setPen(option.palette.color(option.state & QStyle::State_Selected ? QPalette::HighlightedText : QPalette::Text));
+    painter->drawText(textRect, Qt::AlignHCenter | Qt::AlignVCenter, name);
+    painter->restore();
+}
+
+QSize GalleryDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex&) const {
+    // Independent of the row, which is what makes uniformItemSizes valid
+    return QSize(m_iconSize.width() + 2 * kItemMargin, m_iconSize.height() + option.fontMetrics.height() + 2 * kItemMargin);
+}
+
+ImageGalleryWidget::ImageGalleryWidget(QWidget* parent)
+    : QListView(parent), m_model(new GalleryModel(this)), m_delegate(new GalleryDelegate(this)),
+      m_memoryConsumer(0), m_useThumbnailCache(false), m_thumbnailSize(128), m_devicePixelRatio(1.0),
+      m_screenTracked(false), m_thumbnailGeneration(0), m_thumbnailRequests(0),
+      m_deliveryTimer(new QTimer(this)) {
+    setModel(m_model);
+    m_deliveryTimer->setSingleShot(true);
+    m_deliveryTimer->setInterval(kDeliveryIntervalMs);
+    connect(m_deliveryTimer, &QTimer::timeout, this, &ImageGalleryWidget::deliverThumbnails);
+    setItemDelegate(m_delegate);
+    connect(this, &QListView::clicked, this, &ImageGalleryWidget::onItemClicked);
 
-    // Configure the list widget for image gallery appearance
+    connect(m_model, &QAbstractItemModel::modelReset, this, [this]() {
+        // Results still in flight carry the old generation and are dropped on arrival
+        m_thumbnailGeneration.fetchAndAddOrdered(1);
+        DecodeScheduler::instance()->cancelOwner(this);
+        m_thumbnailJobs.clear();
+        m_refreshedThumbnails.clear();
+        reportThumbnailUsage();
+    });
+    // Thumbnails are generated for what is on (or near) screen as the list scrolls
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &ImageGalleryWidget::updateThumbnailRange);
+    connect(horizontalScrollBar(), &QScrollBar::valueChanged, this, &ImageGalleryWidget::updateThumbnailRange);
+    m_memoryConsumer = ImageMemoryGovernor::instance()->registerConsumer(
+        ImageMemoryGovernor::Thumbnails, "Gallery thumbnails",
+        [this](qint64 bytesToFree) { return evictOffscreenThumbnails(bytesToFree); });
+
+    // Configure the view for image gallery appearance
     setViewMode(QListView::IconMode);
-    setIconSize(QSize(128, 128)); // Adjust thumbnail size
+    setMovement(QListView::Static); // IconMode defaults to free dragging, which would fight the model's order
+    setIconSize(QSize(m_thumbnailSize, m_thumbnailSize));
+    m_delegate->setIconSize(iconSize());
+    m_model->setThumbnailSize(iconSize()); // One atlas slot per thumbnail, in device pixels
     setResizeMode(QListView::Adjust);
     setWrapping(false);          // Important for a vertical gallery
     setFlow(QListView::TopToBottom); // Arrange items vertically
     setSpacing(5);               // Spacing between items
-    setUniformItemSizes(true);   // Optimizes rendering for uniform items
+    setUniformItemSizes(true);   // One sizeHint() call lays out every row
+    setSelectionMode(QAbstractItemView::SingleSelection);
+}
+
+ImageGalleryWidget::~ImageGalleryWidget() {
+    DecodeScheduler::instance()->cancelOwner(this);
+    DecodeScheduler::instance()->waitForOwner(this); // Running jobs call back into this widget
+    ImageMemoryGovernor::instance()->unregisterConsumer(m_memoryConsumer);
+    logThumbnailStatistics();
 }
 
-void ImageGalleryWidget::loadImagesFromDirectory(const QString& directory) {
-    clear(); // Clear existing items
+void ImageGalleryWidget::setDirectory(const QString& directory) {
+    logThumbnailStatistics(); // For the directory we are leaving
     m_currentDirectory = directory;
-    QDir dir(directory);
-    QStringList filters;
-    filters << "*.png" << "*.jpg" << "*.jpeg" << "*.bmp" << "*.gif" << "*.tiff" << "*.tif"; // Common image formats
-    QStringList entries = dir.entryList(filters, QDir::Files | QDir::NoDotAndDotDot, QDir::Name); // Sort by name
-
-    for (const QString& fileName : entries) {
-        QListWidgetItem* item = new QListWidgetItem(fileName);
-        // Add placeholder icon immediately
-        // Consider creating a simple placeholder icon resource file (e.g., icons.qrc)
-        // For now, no icon, or replace with a default if you have one.
-        // item->setIcon(QIcon(":/icons/placeholder.png"));
-        addItem(item);
-
-        // Asynchronously generate thumbnail
-        // QtConcurrent::run returns a QFuture, which can be used to monitor completion.
-        // The `item` pointer must be handled carefully as it could be deleted if the list changes.
-        // For this example, we trust the `item` to exist long enough.
-        QtConcurrent::run(this, &ImageGalleryWidget::generateThumbnail, QDir(m_currentDirectory).filePath(fileName), item);
+    m_model->clear(); // Also cancels the previous directory's thumbnails
+}
+
+void ImageGalleryWidget::addImages(const QStringList& fileNames) {
+    m_model->appendFileNames(fileNames);
+    updateThumbnailRange(); // Thumbnails are only generated for rows in or near the viewport
+}
+
+void ImageGalleryWidget::removeImages(const QStringList& fileNames) {
+    for (const QString& fileName : fileNames) {
+        cancelThumbnail(fileName);
     }
-    qDebug() << "Loaded" << entries.size() << "images from" << directory;
-}
-
-void ImageGalleryWidget::generateThumbnail(const QString& imagePath, QListWidgetItem* item) {
-    QImage image(imagePath);
-    if (!image.isNull()) {
-        QPixmap thumbnail = QPixmap::fromImage(image.scaled(iconSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
-        // Update the item's icon on the GUI thread using QMetaObject::invokeMethod
-        // This is crucial for thread safety when modifying GUI elements
-        QMetaObject::invokeMethod(this, [item, thumbnail]() {
-            // Check if item is still valid before updating, especially if list can change dynamically
-            if (item) {
-                item->setIcon(QIcon(thumbnail));
-            }
-        });
-    } else {
-         qWarning() << "Failed to load image for thumbnail:" << imagePath;
+    m_model->removeFileNames(fileNames);
+    reportThumbnailUsage();
+    updateThumbnailRange(); // Rows moved up into the viewport
+}
+
+void ImageGalleryWidget::refreshImages(const QStringList& fileNames) {
+    for (const QString& fileName : fileNames) {
+        const int row = m_model->rowForName(fileName);
+        if (row < 0) continue;
+        // A running job cannot be cancelled and may still deliver the old pixels,
+        // possibly after the new job's result: everything scheduled so far is dropped
+        cancelThumbnail(fileName);
+        m_refreshedThumbnails.insert(fileName, m_thumbnailRequests);
+        m_model->resetThumbnail(row);
+    }
+    reportThumbnailUsage();
+    updateThumbnailRange(); // Only rows in or near the viewport are regenerated now
+}
+
+void ImageGalleryWidget::cancelThumbnail(const QString& fileName) {
+    auto job = m_thumbnailJobs.find(fileName);
+    if (job == m_thumbnailJobs.end()) return;
+    DecodeScheduler::instance()->cancel(job->id);
+    m_thumbnailJobs.erase(job);
+}
+
+void ImageGalleryWidget::clear() {
+    m_model->clear();
+}
+
+void ImageGalleryWidget::setThumbnailSize(int size) {
+    size = qBound(16, size, kMaxThumbnailSize);
+    if (size == m_thumbnailSize) return;
+    m_thumbnailSize = size;
+    setIconSize(QSize(size, size));
+    m_delegate->setIconSize(iconSize());
+    resetThumbnails();
+}
+
+void ImageGalleryWidget::showEvent(QShowEvent* event) {
+    QListView::showEvent(event);
+    // The window handle only exists once shown; follow it across screens from then on
+    if (!m_screenTracked && window()->windowHandle()) {
+        connect(window()->windowHandle(), &QWindow::screenChanged, this, &ImageGalleryWidget::updateDevicePixelRatio);
+        m_screenTracked = true;
     }
+    updateDevicePixelRatio();
+}
+
+void ImageGalleryWidget::updateDevicePixelRatio() {
+    const qreal ratio = devicePixelRatioF();
+    if (qFuzzyCompare(ratio, m_devicePixelRatio)) return;
+    m_devicePixelRatio = ratio;
+    m_delegate->setDevicePixelRatio(ratio);
+    resetThumbnails();
 }
 
+void ImageGalleryWidget::resetThumbnails() {
+    // Results in flight were rendered for the old size and are dropped on arrival
+    m_thumbnailGeneration.fetchAndAddOrdered(1);
+    DecodeScheduler::instance()->cancelOwner(this);
+    m_thumbnailJobs.clear();
+    m_refreshedThumbnails.clear();
+    m_model->setThumbnailSize(iconSize() * m_devicePixelRatio);
+    reportThumbnailUsage();
+    updateThumbnailRange(); // Cache reads (shared or private), not decodes
+}
+
+void ImageGalleryWidget::resizeEvent(QResizeEvent* event) {
+    QListView::resizeEvent(event);
+    updateThumbnailRange(); // More (or fewer) rows fit now
+}
+
+bool ImageGalleryWidget::visibleRows(int* first, int* last) const {
+    const int rows = m_model->rowCount();
+    if (rows == 0 || viewport()->height() <= 0) return false;
+    // Rows are laid out in order, so both ends of the visible range can be bisected
+    const int viewportHeight = viewport()->height();
+    int low = 0, high = rows;
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        if (visualRect(m_model->index(mid)).bottom() < 0) low = mid + 1; else high = mid;
+    }
+    *first = low;
+    high = rows;
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        if (visualRect(m_model->index(mid)).top() < viewportHeight) low = mid + 1; else high = mid;
+    }
+    *last = low - 1;
+    return *first <= *last;
+}
+
+void ImageGalleryWidget::updateThumbnailRange() {
+    DecodeScheduler* scheduler = DecodeScheduler::instance();
+    int first = 0, last = -1;
+    visibleRows(&first, &last);
+    const int margin = qMax(kMinPrefetchRows, last - first + 1); // One screen above and below
+    const int nearFirst = qMax(0, first - margin);
+    const int nearLast = qMin(m_model->rowCount() - 1, last + margin);
+
+    // Jobs for rows that scrolled far away are cancelled, not just deprioritised
+    for (auto it = m_thumbnailJobs.begin(); it != m_thumbnailJobs.end();) {
+        const int row = m_model->rowForName(it.key());
+        if (row >= nearFirst && row <= nearLast) {
+            ++it;
+        } else if (scheduler->cancel(it->id)) {
+            it = m_thumbnailJobs.erase(it);
+        } else {
+            ++it; // Already running, its result is cheap to keep
+        }
+    }
+
+    for (int row = nearFirst; row <= nearLast; ++row) {
+        if (m_model->hasThumbnail(row) || m_model->thumbnailFailed(row)) {
+            continue;
+        }
+        const QString fileName = m_model->fileName(row);
+        const DecodeScheduler::Priority priority = (row >= first && row <= last)
+            ? DecodeScheduler::VisibleThumbnail : DecodeScheduler::OffscreenThumbnail;
+        auto job = m_thumbnailJobs.find(fileName);
+        if (job == m_thumbnailJobs.end()) {
+            scheduleThumbnail(fileName, priority);
+        } else if (job->priority != priority && scheduler->reprioritize(job->id, priority)) {
+            job->priority = priority;
+        }
+    }
+}
+
+void ImageGalleryWidget::scheduleThumbnail(const QString& fileName, DecodeScheduler::Priority priority) {
+    const QString path = QDir(m_currentDirectory).filePath(fileName);
+    const quint64 generation = m_thumbnailGeneration.loadAcquire();
+    const quint64 request = ++m_thumbnailRequests;
+    const QSize targetSize = iconSize() * m_devicePixelRatio;
+    // Every decode also fills the cache for the largest gallery size on this screen,
+    // so a later size switch is served from the cache
+    const ThumbnailCache::Flavor largestFlavor =
+        ThumbnailCache::flavorFor(QSize(kMaxThumbnailSize, kMaxThumbnailSize) * m_devicePixelRatio);
+    DecodeScheduler::Job job;
+    job.priority = priority;
+    // No job.path: most thumbnails come from a cached PNG or the EXIF preview in the
+    // first few KB, and faulting in the whole image in the I/O stage would undo that
+    job.owner = this;
+    job.isStale = [this, generation]() { return m_thumbnailGeneration.loadAcquire() != generation; };
+    const bool useCache = m_useThumbnailCache; // Read here: the setter runs on the GUI thread
+    job.run = [this, path, fileName, generation, request, targetSize, largestFlavor, useCache](const QSharedPointer<MappedFile>&) {
+        QImage thumbnail = ThumbnailGenerator::generate(path, targetSize, useCache, largestFlavor);
+        // Only the push that finds the queue empty posts an event; the others join its batch
+        if (m_finishedThumbnails.push(FinishedThumbnail{fileName, generation, request, thumbnail})) {
+            QMetaObject::invokeMethod(this, [this]() {
+                if (!m_deliveryTimer->isActive()) m_deliveryTimer->start();
+            }, Qt::QueuedConnection);
+        }
+    };
+    m_thumbnailJobs.insert(fileName, PendingThumbnail{DecodeScheduler::instance()->schedule(job), priority, request});
+}
+
+void ImageGalleryWidget::deliverThumbnails() {
+    const quint64 generation = m_thumbnailGeneration.loadAcquire();
+    QVector<QPair<int, QImage>> batch;
+    for (const FinishedThumbnail& finished : m_finishedThumbnails.takeAll()) {
+        if (finished.generation != generation) continue; // From a directory we already left
+        if (finished.request <= m_refreshedThumbnails.value(finished.fileName, 0)) continue; // File rewritten since
+        auto job = m_thumbnailJobs.find(finished.fileName);
+        if (job != m_thumbnailJobs.end() && job->request == finished.request) m_thumbnailJobs.erase(job);
+        const int row = m_model->rowForName(finished.fileName);
+        if (row < 0) continue;
+        if (finished.thumbnail.isNull()) {
+            m_model->setThumbnailFailed(row); // Don't retry on every scroll
+        } else {
+            batch.append(qMakePair(row, finished.thumbnail));
+        }
+    }
+    if (batch.isEmpty()) return;
+    m_model->setThumbnails(batch); // One dataChanged, one viewport update
+    reportThumbnailUsage();
+}
+
+void ImageGalleryWidget::logThumbnailStatistics() {
+    // How often the EXIF preview saved a full decode, per directory
+    if (ThumbnailGenerator::statistics().total() > 0) {
+        qDebug() << "Gallery" << m_currentDirectory << "-" << qPrintable(ThumbnailGenerator::statisticsSummary());
+    }
+    ThumbnailGenerator::resetStatistics();
+}
+
+void ImageGalleryWidget::reportThumbnailUsage() {
+    ImageMemoryGovernor::instance()->reportUsage(m_memoryConsumer, m_model->thumbnailBytes());
+}
+
+qint64 ImageGalleryWidget::evictOffscreenThumbnails(qint64 bytesToFree) {
+    // Spare the rows updateThumbnailRange() keeps ready, or they would be regenerated right away
+    int first = 0, last = -1;
+    visibleRows(&first, &last);
+    const int margin = qMax(kMinPrefetchRows, last - first + 1);
+    const qint64 slotBytes = m_model->thumbnailSlotBytes();
+    qint64 freedSlots = 0;
+    for (int row = 0; row < m_model->rowCount() && freedSlots * slotBytes < bytesToFree; ++row) {
+        if (row >= first - margin && row <= last + margin) continue;
+        if (!m_model->hasThumbnail(row)) continue;
+        m_model->releaseThumbnail(row); // Regenerated by updateThumbnailRange() when scrolled back
+        ++freedSlots;
+    }
+    // Freed slots only return memory once the survivors are packed into fewer pages
+    const qint64 released = m_model->compactThumbnails();
+    reportThumbnailUsage();
+    return released;
+}
 
 QString ImageGalleryWidget::currentImagePath() const {
-    if (currentItem()) {
-        return QDir(m_currentDirectory).filePath(currentItem()->text());
+    const QModelIndex index = currentIndex();
+    if (index.isValid()) {
+        return QDir(m_currentDirectory).filePath(m_model->fileName(index.row()));
     }
     return QString();
 }
 
 void ImageGalleryWidget::selectImage(const QString& path) {
     QFileInfo fileInfo(path);
-    QList<QListWidgetItem*> items = findItems(fileInfo.fileName(), Qt::MatchExactly);
-    if (!items.isEmpty()) {
-        setCurrentItem(items.first());
-        scrollToItem(items.first()); // Scroll to the selected item
+    const int row = m_model->rowForName(fileInfo.fileName());
+    if (row >= 0) {
+        const QModelIndex index = m_model->index(row);
+        setCurrentIndex(index);
+        scrollTo(index); // Scroll to the selected item
     } else {
         qDebug() << "Could not find item for path:" << path;
     }
 }
 
-void ImageGalleryWidget::onItemClicked(QListWidgetItem* item) {
-    emit imageSelected(QDir(m_currentDirectory).filePath(item->text()));
-}
\ No newline at end of file
+void ImageGalleryWidget::setImageHeaders(const QHash<QString, ImageHeaderInfo>& headers) {
+    m_model->setHeaders(m_currentDirectory, headers);
+}
+
+void ImageGalleryWidget::setImageOrder(const QStringList& fileNames) {
+    m_model->setOrder(fileNames); // The current index follows its row
+    const QModelIndex selected = currentIndex();
+    if (selected.isValid()) {
+        scrollTo(selected);
+    }
+    updateThumbnailRange(); // Different items are on screen now
+}
+
+void ImageGalleryWidget::onItemClicked(const QModelIndex& index) {
+    emit imageSelected(QDir(m_currentDirectory).filePath(m_model->fileName(index.row())));
+}
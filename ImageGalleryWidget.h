@@ -1,32 +1,120 @@
 #ifndef IMAGEGALLERYWIDGET_H
 #define IMAGEGALLERYWIDGET_H
 
-#include <QListWidget>
+#include <QListView>
+#include <QStyledItemDelegate>
 #include <QString>
-#include <QListWidgetItem>
 #include <QSize>       // For icon size
-#include <QFuture>     // For QtConcurrent::run
-#include <QIcon>       // For QIcon
-#include <QPixmap>     // For QPixmap
+#include <QHash>
+#include <QStringList>
+#include <QAtomicInteger>
+#include <QResizeEvent>
+#include <QShowEvent>
+#include <QTimer>
+#include "ImageHeaderParser.h"
+#include "DecodeScheduler.h"
+#include "LockFreeQueue.h"
 
-class ImageGalleryWidget : public QListWidget {
+class GalleryModel;
+
+// Paints one gallery row straight from the model: thumbnail (or an empty frame
+// while it is generated) and the elided file name. No per-row QIcon needed.
+class GalleryDelegate : public QStyledItemDelegate {
+public:
+    explicit GalleryDelegate(QObject* parent = nullptr) : QStyledItemDelegate(parent) {}
+
+    // Both in logical pixels; a changed size re-lays out the view
+    void setIconSize(const QSize& size) { m_iconSize = size; emit sizeHintChanged(QModelIndex()); }
+    void setDevicePixelRatio(qreal ratio) { m_devicePixelRatio = ratio; }
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+private:
+    QSize m_iconSize;
+    qreal m_devicePixelRatio = 1.0;
+};
+
+class ImageGalleryWidget : public QListView {
     Q_OBJECT
 public:
     ImageGalleryWidget(QWidget* parent = nullptr);
-    void loadImagesFromDirectory(const QString& directory);
+    ~ImageGalleryWidget();
+    // Starts an empty gallery for directory; its images arrive through addImages()
+    // while the directory is being listed
+    void setDirectory(const QString& directory);
+    void addImages(const QStringList& fileNames); // Names relative to the directory
+    void removeImages(const QStringList& fileNames);
+    void refreshImages(const QStringList& fileNames); // Files changed on disk: thumbnail them again
+    void clear();
     QString currentImagePath() const;
     void selectImage(const QString& path); // Selects an image in the gallery by path
 
+    // Edge length of the thumbnails in logical pixels (64, 128 or 256). Thumbnails
+    // are rendered at this size times the screen's device pixel ratio.
+    void setThumbnailSize(int size);
+    int thumbnailSize() const { return m_thumbnailSize; }
+    static const int kMaxThumbnailSize = 256;
+
+    // Read and write thumbnails through the shared freedesktop cache (~/.cache/thumbnails)
+    void setThumbnailCacheEnabled(bool enabled) { m_useThumbnailCache = enabled; }
+
+    // Header metadata (keyed by full path) shown as tooltips and kept for sorting
+    void setImageHeaders(const QHash<QString, ImageHeaderInfo>& headers);
+    // Reorders the items to follow fileNames (names relative to the current directory)
+    void setImageOrder(const QStringList& fileNames);
+
 signals:
     void imageSelected(const QString& imagePath);
 
+protected:
+    void resizeEvent(QResizeEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+
 private slots:
-    void onItemClicked(QListWidgetItem* item);
-    // This will be run in a separate thread. Item lifetime must be managed carefully.
-    void generateThumbnail(const QString& imagePath, QListWidgetItem* item);
+    void onItemClicked(const QModelIndex& index);
+    void updateThumbnailRange(); // Schedules thumbnails in and near the viewport, cancels far-away ones
+    void deliverThumbnails();    // Drains m_finishedThumbnails into the model in one batch
 
 private:
+    struct PendingThumbnail {
+        DecodeScheduler::JobId id;
+        DecodeScheduler::Priority priority;
+        quint64 request;
+    };
+    struct FinishedThumbnail {
+        QString fileName;
+        quint64 generation;
+        quint64 request; // Orders results for the same file, see m_refreshedThumbnails
+        QImage thumbnail; // Null when generation failed
+    };
+
+    void scheduleThumbnail(const QString& fileName, DecodeScheduler::Priority priority);
+    void cancelThumbnail(const QString& fileName);
+    bool visibleRows(int* first, int* last) const;
+    qint64 evictOffscreenThumbnails(qint64 bytesToFree);
+    void reportThumbnailUsage();
+    void resetThumbnails(); // Drops all thumbnails and jobs, e.g. after a size or screen change
+    void updateDevicePixelRatio();
+    void logThumbnailStatistics();
+
+    GalleryModel* m_model;
+    GalleryDelegate* m_delegate;
     QString m_currentDirectory;
+    int m_memoryConsumer;
+    bool m_useThumbnailCache;
+    int m_thumbnailSize;
+    qreal m_devicePixelRatio;
+    bool m_screenTracked; // Connected to the window's screenChanged()
+    // Bumped on every directory or thumbnail size change, read by workers. Together with
+    // the file name it identifies a thumbnail result, so results never hold row pointers.
+    QAtomicInteger<quint64> m_thumbnailGeneration;
+    QHash<QString, PendingThumbnail> m_thumbnailJobs; // Queued or running thumbnail jobs by file name
+    quint64 m_thumbnailRequests; // Last request number handed to a thumbnail job
+    // Request number at the last refresh of a rewritten file: results up to it show the old contents
+    QHash<QString, quint64> m_refreshedThumbnails;
+    // Filled by the workers, drained on the GUI thread at most once per frame
+    LockFreeQueue<FinishedThumbnail> m_finishedThumbnails;
+    QTimer* m_deliveryTimer;
 };
 
-#endif // IMAGEGALLERYWIDGET_H
\ No newline at end of file
+#endif // IMAGEGALLERYWIDGET_H
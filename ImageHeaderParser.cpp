@@ -0,0 +1,273 @@
+#include "ImageHeaderParser.h"
+#include <QFile>
+#include <QFileInfo>
+#include <cstring>
+
+namespace {
+
+// parseFile() reads this much first. EXIF, ICC and XMP segments usually fit; anything
+// pointing further in grows the read, up to the cap.
+const qint64 kInitialReadBytes = 64 * 1024;
+const qint64 kMaxReadBytes = 16 * 1024 * 1024;
+
+void want(qint64* wanted, qint64 end) {
+    if (wanted && end > *wanted) *wanted = end;
+}
+
+// Bounds-checked reader over a TIFF structure (a TIFF file, or the EXIF block of a JPEG/PNG)
+class TiffReader {
+public:
+    // wanted, if set, collects the furthest byte a read past size asked for
+    TiffReader(const uchar* data, qint64 size, qint64* wanted = nullptr)
+        : m_data(data), m_size(size), m_wanted(wanted), m_bigEndian(false) {}
+
+    bool readHeader(quint32* firstIfd) {
+        if (m_size < 8) return false;
+        if (m_data[0] == 'I' && m_data[1] == 'I') m_bigEndian = false;
+        else if (m_data[0] == 'M' && m_data[1] == 'M') m_bigEndian = true;
+        else return false;
+        quint16 magic = 0;
+        return u16(2, &magic) && magic == 42 && u32(4, firstIfd);
+    }
+
+    bool u16(qint64 offset, quint16* value) const {
+        if (offset < 0 || offset + 2 > m_size) {
+            if (offset >= 0) want(m_wanted, offset + 2);
+            return false;
+        }
+        const uchar* p = m_data + offset;
+        *value = m_bigEndian ? quint16(p[0] << 8 | p[1]) : quint16(p[1] << 8 | p[0]);
+        return true;
+    }
+
+    bool u32(qint64 offset, quint32* value) const {
+        if (offset < 0 || offset + 4 > m_size) {
+            if (offset >= 0) want(m_wanted, offset + 4);
+            return false;
+        }
+        const uchar* p = m_data + offset;
+        *value = m_bigEndian ? (quint32(p[0]) << 24 | quint32(p[1]) << 16 | quint32(p[2]) << 8 | p[3])
+                             : (quint32(p[3]) << 24 | quint32(p[2]) << 16 | quint32(p[1]) << 8 | p[0]);
+        return true;
+    }
+
+    // Walks one IFD, calling visit(tag, type, count, valueOffset) for each entry.
+    // valueOffset points at the value itself, inline or not. Returns the next IFD offset.
+    template <typename Visitor>
+    quint32 walkIfd(quint32 ifdOffset, Visitor visit) const {
+        quint16 count = 0;
+        if (!u16(ifdOffset, &count)) return 0;
+        for (quint16 i = 0; i < count; ++i) {
+            const qint64 entry = qint64(ifdOffset) + 2 + i * 12;
+            quint16 tag = 0, type = 0;
+            quint32 valueCount = 0, valueOffset = 0;
+            if (!u16(entry, &tag) || !u16(entry + 2, &type) || !u32(entry + 4, &valueCount)) return 0;
+            const qint64 bytes = qint64(typeSize(type)) * valueCount;
+            if (bytes <= 4) {
+                valueOffset = quint32(entry + 8);
+            } else if (!u32(entry + 8, &valueOffset)) {
+                return 0;
+            }
+            visit(tag, type, valueCount, valueOffset);
+        }
+        quint32 next = 0;
+        u32(qint64(ifdOffset) + 2 + count * 12, &next);
+        return next;
+    }
+
+    quint32 uintValue(quint16 type, quint32 offset) const {
+        if (type == 3) { quint16 v = 0; u16(offset, &v); return v; }
+        if (type == 4) { quint32 v = 0; u32(offset, &v); return v; }
+        return 0;
+    }
+
+    double rationalValue(quint32 offset) const {
+        quint32 numerator = 0, denominator = 0;
+        if (!u32(offset, &numerator) || !u32(offset + 4, &denominator) || denominator == 0) return 0;
+        return double(numerator) / denominator;
+    }
+
+    QString stringValue(quint32 offset, quint32 count) const {
+        if (qint64(offset) + count > m_size) {
+            want(m_wanted, qint64(offset) + count);
+            return QString();
+        }
+        const char* text = reinterpret_cast<const char*>(m_data + offset);
+        return QString::fromLatin1(text, int(qstrnlen(text, count))).trimmed();
+    }
+
+private:
+    static int typeSize(quint16 type) {
+        switch (type) {
+        case 3: case 8: return 2;           // SHORT, SSHORT
+        case 4: case 9: case 11: return 4;  // LONG, SLONG, FLOAT
+        case 5: case 10: case 12: return 8; // RATIONAL, SRATIONAL, DOUBLE
+        default: return 1;                  // BYTE, ASCII, UNDEFINED, ...
+        }
+    }
+
+    const uchar* m_data;
+    qint64 m_size;
+    qint64* m_wanted;
+    bool m_bigEndian;
+};
+
+QDateTime exifDateTime(const QString& text) {
+    return QDateTime::fromString(text, QStringLiteral("yyyy:MM:dd HH:mm:ss"));
+}
+
+// Parses a TIFF structure. baseOffset is where it starts inside the file, so the
+// thumbnail range can be reported in file offsets. wanted is only passed for a whole
+// TIFF file, whose IFDs may sit anywhere in it; an EXIF block is always read whole.
+void parseTiff(const uchar* data, qint64 size, qint64 baseOffset, bool takeDimensions, ImageHeaderInfo* info,
+               qint64* wanted = nullptr) {
+    TiffReader reader(data, size, wanted);
+    quint32 ifd0 = 0;
+    if (!reader.readHeader(&ifd0)) return;
+
+    quint32 exifIfd = 0;
+    QDateTime modified;
+    const quint32 ifd1 = reader.walkIfd(ifd0, [&](quint16 tag, quint16 type, quint32 count, quint32 offset) {
+        switch (tag) {
+        case 256: if (takeDimensions) info->size.setWidth(int(reader.uintValue(type, offset))); break;
+        case 257: if (takeDimensions) info->size.setHeight(int(reader.uintValue(type, offset))); break;
+        case 271: info->cameraMake = reader.stringValue(offset, count); break;
+        case 272: info->cameraModel = reader.stringValue(offset, count); break;
+        case 274: info->orientation = int(reader.uintValue(type, offset)); break;
+        case 306: modified = exifDateTime(reader.stringValue(offset, count)); break;
+        case 34665: exifIfd = reader.uintValue(type, offset); break;
+        default: break;
+        }
+    });
+
+    if (exifIfd) {
+        reader.walkIfd(exifIfd, [&](quint16 tag, quint16 type, quint32 count, quint32 offset) {
+            switch (tag) {
+            case 33434: info->exposureTime = reader.rationalValue(offset); break;
+            case 33437: info->fNumber = reader.rationalValue(offset); break;
+            case 34855: info->isoSpeed = int(reader.uintValue(type, offset)); break;
+            case 36867: info->captureTime = exifDateTime(reader.stringValue(offset, count)); break;
+            case 37386: info->focalLength = reader.rationalValue(offset); break;
+            default: break;
+            }
+        });
+    }
+    if (!info->captureTime.isValid()) {
+        info->captureTime = modified;
+    }
+
+    if (ifd1) {
+        quint32 thumbnailOffset = 0, thumbnailLength = 0;
+        reader.walkIfd(ifd1, [&](quint16 tag, quint16 type, quint32, quint32 offset) {
+            if (tag == 513) thumbnailOffset = reader.uintValue(type, offset);
+            else if (tag == 514) thumbnailLength = reader.uintValue(type, offset);
+        });
+        if (thumbnailOffset && thumbnailLength && qint64(thumbnailOffset) + thumbnailLength <= size) {
+            info->thumbnailOffset = baseOffset + thumbnailOffset;
+            info->thumbnailLength = thumbnailLength;
+        } else if (thumbnailOffset && thumbnailLength) {
+            want(wanted, qint64(thumbnailOffset) + thumbnailLength); // Only its range is kept, but it must exist
+        }
+    }
+}
+
+void parseJpeg(const uchar* data, qint64 size, ImageHeaderInfo* info, qint64* wanted) {
+    info->format = QStringLiteral("JPEG");
+    qint64 pos = 2; // After SOI
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return; // Lost sync, give up rather than guess
+        const uchar marker = data[pos + 1];
+        if (marker == 0xFF) { ++pos; continue; } // Fill byte
+        if (marker == 0xD8 || (marker >= 0xD0 && marker <= 0xD7) || marker == 0x01) { pos += 2; continue; }
+        if (marker == 0xD9 || marker == 0xDA) return; // EOI or start of scan: no more headers
+
+        const int length = data[pos + 2] << 8 | data[pos + 3];
+        const qint64 segment = pos + 4;
+        if (length < 2) return;
+        if (pos + 2 + length > size) {
+            want(wanted, pos + 2 + length + 4); // The segment and the next marker
+            return;
+        }
+
+        const bool startOfFrame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (startOfFrame && length >= 7) {
+            info->size = QSize(data[segment + 3] << 8 | data[segment + 4], data[segment + 1] << 8 | data[segment + 2]);
+            info->progressive = (marker & 0x03) == 0x02;
+            return; // EXIF always precedes the frame header
+        }
+        if (marker == 0xE1 && length >= 8 && memcmp(data + segment, "Exif\0\0", 6) == 0) {
+            parseTiff(data + segment + 6, length - 8, segment + 6, false, info);
+        }
+        pos += 2 + length;
+    }
+    want(wanted, pos + 4); // Ran out of data before the frame header
+}
+
+void parsePng(const uchar* data, qint64 size, ImageHeaderInfo* info, qint64* wanted) {
+    info->format = QStringLiteral("PNG");
+    auto be32 = [data](qint64 offset) {
+        return quint32(data[offset]) << 24 | quint32(data[offset + 1]) << 16 | quint32(data[offset + 2]) << 8 | data[offset + 3];
+    };
+    qint64 pos = 8; // After the signature
+    while (pos + 12 <= size) {
+        const quint32 length = be32(pos);
+        const uchar* type = data + pos + 4;
+        const qint64 chunk = pos + 8;
+        if (chunk + length + 4 > size) {
+            want(wanted, chunk + length + 4 + 12); // The chunk and the next chunk's header
+            return;
+        }
+        if (memcmp(type, "IHDR", 4) == 0 && length >= 8) {
+            info->size = QSize(int(be32(chunk)), int(be32(chunk + 4)));
+        } else if (memcmp(type, "eXIf", 4) == 0) {
+            parseTiff(data + chunk, length, chunk, false, info);
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            return; // Pixel data from here on
+        }
+        pos = chunk + length + 4; // Skip data and CRC
+    }
+}
+
+ImageHeaderInfo parseData(const uchar* data, qint64 size, qint64* wanted) {
+    ImageHeaderInfo info;
+    if (!data || size < 8) return info;
+
+    if (data[0] == 0xFF && data[1] == 0xD8) {
+        parseJpeg(data, size, &info, wanted);
+    } else if (memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        parsePng(data, size, &info, wanted);
+    } else if ((data[0] == 'I' && data[1] == 'I') || (data[0] == 'M' && data[1] == 'M')) {
+        info.format = QStringLiteral("TIFF");
+        parseTiff(data, size, 0, true, &info, wanted);
+    }
+    return info;
+}
+
+} // namespace
+
+ImageHeaderInfo ImageHeaderParser::parse(const uchar* data, qint64 size) {
+    return parseData(data, size, nullptr);
+}
+
+ImageHeaderInfo ImageHeaderParser::parseFile(const QString& path) {
+    ImageHeaderInfo info;
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly)) {
+        // A plain bounded read: MappedFile falls back to reading the whole file when it
+        // cannot map it (or it was just written), which a directory-wide batch can't afford
+        const qint64 limit = qMin(file.size(), kMaxReadBytes);
+        QByteArray head = file.read(qMin(limit, kInitialReadBytes));
+        for (;;) {
+            qint64 wanted = 0;
+            info = parseData(reinterpret_cast<const uchar*>(head.constData()), head.size(), &wanted);
+            if (wanted <= head.size() || head.size() >= limit) break;
+            const qint64 target = qMin(limit, qMax(wanted, 2 * qint64(head.size())));
+            const QByteArray more = file.read(target - head.size());
+            if (more.isEmpty()) break; // Shorter than it claimed
+            head.append(more);
+        }
+        info.lastModified = QFileInfo(file).lastModified();
+    }
+    info.path = path;
+    return info;
+}
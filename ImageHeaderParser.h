@@ -0,0 +1,41 @@
+#ifndef IMAGEHEADERPARSER_H
+#define IMAGEHEADERPARSER_H
+
+#include <QDateTime>
+#include <QSize>
+#include <QString>
+
+// What can be learned from an image without decoding a single pixel
+struct ImageHeaderInfo {
+    QString path;
+    QDateTime lastModified;  // Of the file when it was parsed
+    QString format;          // "JPEG", "PNG" or "TIFF"; empty when not recognized
+    QSize size;              // Stored pixel size, before EXIF orientation
+    bool progressive = false; // Progressive JPEG (SOF2, SOF6, SOF10, SOF14)
+    int orientation = 0;     // EXIF orientation 1-8, 0 when absent
+    QDateTime captureTime;   // DateTimeOriginal, falling back to DateTime
+    QString cameraMake;
+    QString cameraModel;
+    double exposureTime = 0; // Seconds
+    double fNumber = 0;
+    int isoSpeed = 0;
+    double focalLength = 0;  // Millimetres
+
+    // Embedded JPEG thumbnail from EXIF IFD1, as a byte range of the file
+    qint64 thumbnailOffset = 0;
+    qint64 thumbnailLength = 0;
+
+    bool isValid() const { return size.isValid(); }
+};
+
+// Parses JPEG markers up to the first scan (SOFn, APP1/EXIF), PNG chunks up to the
+// first IDAT (IHDR, eXIf) and TIFF IFD0/EXIF IFD/IFD1. Only a few KB at the start of
+// the file are ever touched, so with a mapped file only those pages are read.
+// parseFile() reads 64 KB and more only where the headers point further in (16 MB at most).
+class ImageHeaderParser {
+public:
+    static ImageHeaderInfo parse(const uchar* data, qint64 size);
+    static ImageHeaderInfo parseFile(const QString& path);
+};
+
+#endif // IMAGEHEADERPARSER_H
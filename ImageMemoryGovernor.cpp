@@ -0,0 +1,81 @@
+#include "ImageMemoryGovernor.h"
+#include <QDebug>
+
+ImageMemoryGovernor::ImageMemoryGovernor(QObject* parent)
+    : QObject(parent), m_nextId(1), m_budget(1024LL * 1024 * 1024), m_total(0), m_enforcing(false) {}
+
+ImageMemoryGovernor* ImageMemoryGovernor::instance() {
+    static ImageMemoryGovernor governor;
+    return &governor;
+}
+
+int ImageMemoryGovernor::registerConsumer(Category category, const QString& name, const Evictor& evictor) {
+    const int id = m_nextId++;
+    m_consumers.insert(id, Consumer{category, name, evictor, 0});
+    return id;
+}
+
+void ImageMemoryGovernor::unregisterConsumer(int consumerId) {
+    auto it = m_consumers.find(consumerId);
+    if (it == m_consumers.end()) return;
+    m_total -= it->bytes;
+    m_consumers.erase(it);
+    emit usageChanged(m_total, m_budget);
+}
+
+void ImageMemoryGovernor::reportUsage(int consumerId, qint64 bytes) {
+    auto it = m_consumers.find(consumerId);
+    if (it == m_consumers.end() || it->bytes == bytes) return;
+    m_total += bytes - it->bytes;
+    it->bytes = bytes;
+    enforceBudget();
+    emit usageChanged(m_total, m_budget);
+}
+
+void ImageMemoryGovernor::setBudget(qint64 bytes) {
+    m_budget = qMax<qint64>(0, bytes);
+    enforceBudget();
+    emit usageChanged(m_total, m_budget);
+}
+
+qint64 ImageMemoryGovernor::usage(Category category) const {
+    qint64 bytes = 0;
+    for (const Consumer& consumer : m_consumers) {
+        if (consumer.category == category) bytes += consumer.bytes;
+    }
+    return bytes;
+}
+
+QString ImageMemoryGovernor::usageSummary() const {
+    static const char* const names[CategoryCount] = {"Prefetch cache", "Undo snapshots", "Thumbnails", "Viewer tiles", "Viewer"};
+    QString summary;
+    for (int category = 0; category < CategoryCount; ++category) {
+        summary += QString("%1: %2 MB\n").arg(names[category]).arg(usage(Category(category)) / (1024 * 1024));
+    }
+    summary += QString("Total: %1 / %2 MB").arg(m_total / (1024 * 1024)).arg(m_budget / (1024 * 1024));
+    return summary;
+}
+
+void ImageMemoryGovernor::enforceBudget() {
+    if (m_enforcing || m_total <= m_budget) return;
+    m_enforcing = true;
+    for (int category = 0; category < Viewer && m_total > m_budget; ++category) {
+        // Copy the ids: an evictor may unregister other consumers while releasing memory
+        const QList<int> ids = m_consumers.keys();
+        for (int id : ids) {
+            if (m_total <= m_budget) break;
+            auto it = m_consumers.constFind(id);
+            if (it == m_consumers.constEnd() || it->category != category || !it->evictor) continue;
+            const Evictor evictor = it->evictor;
+            const qint64 released = evictor(m_total - m_budget);
+            if (released > 0) {
+                qDebug() << "Memory budget exceeded, released" << released / 1024 << "KB from" << m_consumers.value(id).name;
+            }
+        }
+    }
+    if (m_total > m_budget) {
+        // What is left is on screen; go over budget rather than blank the view
+        qDebug() << "Memory budget still exceeded after eviction:\n" << qPrintable(usageSummary());
+    }
+    m_enforcing = false;
+}
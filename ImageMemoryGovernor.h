@@ -0,0 +1,66 @@
+#ifndef IMAGEMEMORYGOVERNOR_H
+#define IMAGEMEMORYGOVERNOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <functional>
+
+// Central accountant for decoded pixel memory. Every owner of image buffers
+// (viewer, decoded-image cache, undo history, gallery thumbnails) registers a
+// consumer and reports its current byte count. When the total exceeds the
+// budget, evictable consumers are asked to release memory in category order:
+// prefetch cache first, then undo snapshots, then offscreen thumbnails, then
+// the least recently painted tiles of a tiled image.
+// GUI thread only, like the consumers it tracks.
+class ImageMemoryGovernor : public QObject {
+    Q_OBJECT
+public:
+    // Declaration order is eviction order; Viewer is never evicted
+    enum Category {
+        PrefetchCache,
+        UndoSnapshots,
+        Thumbnails,
+        ViewerTiles,
+        Viewer,
+        CategoryCount
+    };
+
+    // Releases up to bytesToFree and returns the number of bytes actually released.
+    // The consumer reports its new usage itself (usually from inside the evictor).
+    using Evictor = std::function<qint64(qint64 bytesToFree)>;
+
+    static ImageMemoryGovernor* instance();
+
+    int registerConsumer(Category category, const QString& name, const Evictor& evictor = Evictor());
+    void unregisterConsumer(int consumerId);
+    void reportUsage(int consumerId, qint64 bytes);
+
+    void setBudget(qint64 bytes);
+    qint64 budget() const { return m_budget; }
+    qint64 totalUsage() const { return m_total; }
+    qint64 usage(Category category) const;
+    QString usageSummary() const; // One line per category, for logs and tooltips
+
+signals:
+    void usageChanged(qint64 totalBytes, qint64 budgetBytes);
+
+private:
+    explicit ImageMemoryGovernor(QObject* parent = nullptr);
+    void enforceBudget();
+
+    struct Consumer {
+        Category category;
+        QString name;
+        Evictor evictor;
+        qint64 bytes;
+    };
+
+    QHash<int, Consumer> m_consumers;
+    int m_nextId;
+    qint64 m_budget;
+    qint64 m_total;
+    bool m_enforcing; // Evictors report back while we iterate
+};
+
+#endif // IMAGEMEMORYGOVERNOR_H
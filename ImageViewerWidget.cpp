@@ -7,9 +7,136 @@
 #include <QResizeEvent>
 #include <QMouseEvent>
 #include <QRgb> // For pixel manipulation
+#include <QMutexLocker>
+#include "DecodeScheduler.h" // Tiles are decoded as VisibleImage jobs
+#include "ImageMemoryGovernor.h"
+#include "OrthogonalTransform.h"
+
+namespace {
+const int kMaxVisibleTiles = 64; // Beyond this the overview is drawn instead
+const qint64 kTileCacheBytes = 256LL * 1024 * 1024;
+
+QString tileKey(int column, int row) {
+    return QString::number(column) + QLatin1Char(',') + QString::number(row);
+}
+
+const int kPyramidMinimumExtent = 1024; // Smaller images are resampled directly
+const int kPyramidSmallestLevel = 256;
+const int kSettleMs = 150; // Input pause after which a zoom or pan counts as finished
+
+// 2x2 box filter to half size (rounded up, an odd last row or column is averaged with
+// itself). image must be RGB32 or ARGB32_Premultiplied; both channel pairs of a pixel
+// are summed at once in 0x00ff00ff lanes.
+QImage halved(const QImage& image) {
+    const int width = image.width();
+    const int height = image.height();
+    QImage result((width + 1) / 2, (height + 1) / 2, image.format());
+    for (int y = 0; y < result.height(); ++y) {
+        const quint32* top = reinterpret_cast<const quint32*>(image.constScanLine(2 * y));
+        const quint32* bottom = reinterpret_cast<const quint32*>(image.constScanLine(qMin(2 * y + 1, height - 1)));
+        quint32* line = reinterpret_cast<quint32*>(result.scanLine(y));
+        for (int x = 0; x < result.width(); ++x) {
+            const int left = 2 * x;
+            const int right = qMin(left + 1, width - 1);
+            const quint32 rb = (top[left] & 0x00ff00ff) + (top[right] & 0x00ff00ff)
+                             + (bottom[left] & 0x00ff00ff) + (bottom[right] & 0x00ff00ff) + 0x00020002;
+            const quint32 ag = ((top[left] >> 8) & 0x00ff00ff) + ((top[right] >> 8) & 0x00ff00ff)
+                             + ((bottom[left] >> 8) & 0x00ff00ff) + ((bottom[right] >> 8) & 0x00ff00ff) + 0x00020002;
+            line[x] = ((rb >> 2) & 0x00ff00ff) | (((ag >> 2) & 0x00ff00ff) << 8);
+        }
+    }
+    return result;
+}
+
+QVector<QImage> buildPyramid(const QImage& image) {
+    QVector<QImage> levels;
+    QImage level = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    while (qMax(level.width(), level.height()) > kPyramidSmallestLevel) {
+        level = halved(level);
+        levels.append(level);
+    }
+    return levels;
+}
+
+// Area-averaged render of level into a deviceSize image, for a view that shrinks the
+// level (levelToDevice scales by less than 1). Only the visible part of level is read.
+QImage renderRefined(const QImage& level, const QTransform& levelToDevice, const QSize& deviceSize) {
+    const QRect pixels = levelToDevice.inverted().mapRect(QRectF(QPointF(0, 0), QSizeF(deviceSize)))
+                             .toAlignedRect().adjusted(-1, -1, 1, 1).intersected(level.rect());
+    if (pixels.isEmpty()) return QImage();
+    // A view onto the level's own bits, no copy (read only; level outlives it)
+    QImage region = level.depth() >= 8
+        ? QImage(level.constScanLine(pixels.top()) + pixels.left() * (level.depth() / 8), pixels.width(), pixels.height(),
+                 level.bytesPerLine(), level.format())
+        : level.copy(pixels);
+    if (level.format() == QImage::Format_Indexed8) region.setColorTable(level.colorTable());
+
+    // Scale first with the box filter, then place the result, which is drawn at about 1:1
+    const qreal scale = qSqrt(qAbs(levelToDevice.determinant()));
+    const QSize scaledSize(qMax(1, qRound(pixels.width() * scale)), qMax(1, qRound(pixels.height() * scale)));
+    const QImage scaled = region.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    const QTransform scaledToDevice = QTransform::fromScale(qreal(pixels.width()) / scaled.width(),
+                                                            qreal(pixels.height()) / scaled.height())
+                                    * QTransform::fromTranslate(pixels.left(), pixels.top()) * levelToDevice;
+
+    QImage result(deviceSize, QImage::Format_ARGB32_Premultiplied);
+    result.fill(Qt::transparent);
+    QPainter painter(&result);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.setTransform(scaledToDevice);
+    painter.drawImage(QPointF(0, 0), scaled);
+    return result;
+}
+
+QImage grayscaleFilter(const QImage& image) {
+    return image.convertToFormat(QImage::Format_Grayscale8);
+}
+
+QImage sepiaFilter(const QImage& image) {
+    QImage processedImage = image;
+
+    // Convert to compatible format for pixel manipulation if needed
+    if (processedImage.format() == QImage::Format_Indexed8 || processedImage.format() == QImage::Format_Grayscale8) {
+        processedImage = processedImage.convertToFormat(QImage::Format_RGB32);
+    } else if (processedImage.format() != QImage::Format_RGB32 && processedImage.format() != QImage::Format_ARGB32 && processedImage.format() != QImage::Format_ARGB32_Premultiplied) {
+        processedImage = processedImage.convertToFormat(QImage::Format_ARGB32);
+    }
+
+    for (int y = 0; y < processedImage.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb*>(processedImage.scanLine(y));
+        for (int x = 0; x < processedImage.width(); ++x) {
+            int r = qRed(line[x]);
+            int g = qGreen(line[x]);
+            int b = qBlue(line[x]);
+
+            int newR = qMin(255, static_cast<int>(0.393 * r + 0.769 * g + 0.189 * b));
+            int newG = qMin(255, static_cast<int>(0.349 * r + 0.686 * g + 0.168 * b));
+            int newB = qMin(255, static_cast<int>(0.272 * r + 0.534 * g + 0.131 * b));
+
+            line[x] = qRgb(newR, newG, newB);
+        }
+    }
+    return processedImage;
+}
+
+QImage negativeFilter(const QImage& image) {
+    QImage processedImage = image;
+    processedImage.invertPixels();
+    return processedImage;
+}
+}
 
 ImageViewerWidget::ImageViewerWidget(QWidget* parent)
     : QWidget(parent),
+      m_tileGeneration(0),
+      m_fullResolutionRequested(false),
+      m_progressive(false),
+      m_memoryConsumer(0),
+      m_tileMemoryConsumer(0),
+      m_pyramidGeneration(0),
+      m_pyramidJob(0),
+      m_interacting(false),
+      m_refineJob(0),
       m_zoomFactor(1.0),
       m_rotationAngle(0.0),
       m_flippedHorizontal(false),
@@ -18,29 +145,263 @@ ImageViewerWidget::ImageViewerWidget(QWidget* parent)
     setBackgroundRole(QPalette::Dark);
     setAutoFillBackground(true);
     setMouseTracking(true);
+
+    m_tileCache.setMaxBytes(kTileCacheBytes);
+    // Accounted but never evicted: this is what is on screen
+    m_memoryConsumer = ImageMemoryGovernor::instance()->registerConsumer(ImageMemoryGovernor::Viewer, "Viewer");
+    // Tiles are re-read from the file when painted again; the least recently painted go first
+    m_tileMemoryConsumer = ImageMemoryGovernor::instance()->registerConsumer(
+        ImageMemoryGovernor::ViewerTiles, "Viewer tiles", [this](qint64 bytesToFree) {
+            const qint64 released = m_tileCache.evict(bytesToFree);
+            reportMemoryUsage();
+            return released;
+        });
+
+    m_settleTimer.setSingleShot(true);
+    m_settleTimer.setInterval(kSettleMs);
+    connect(&m_settleTimer, &QTimer::timeout, this, [this]() {
+        m_interacting = false;
+        update(); // Repaints smoothly and asks for the refined render
+    });
+
+    connect(&m_animationPlayer, &AnimationPlayer::frameReady, this, [this](const QImage& frame) {
+        m_animationFrame = frame;
+        update(); // Painted through viewTransform(), no per-frame rescale of the whole image
+    });
+}
+
+ImageViewerWidget::~ImageViewerWidget() {
+    clearTiles();
+    // Tile jobs reference this widget
+    DecodeScheduler::instance()->cancelOwner(this);
+    DecodeScheduler::instance()->waitForOwner(this);
+    ImageMemoryGovernor::instance()->unregisterConsumer(m_memoryConsumer);
+    ImageMemoryGovernor::instance()->unregisterConsumer(m_tileMemoryConsumer);
+}
+
+void ImageViewerWidget::reportMemoryUsage() {
+    // The source and filtered images are often the same shared buffer
+    QSet<qint64> counted;
+    qint64 bytes = 0;
+    for (const QImage* image : {&m_originalImageSource, &m_originalImage, &m_animationFrame, &m_refined}) {
+        if (!image->isNull() && !counted.contains(image->cacheKey())) {
+            counted.insert(image->cacheKey());
+            bytes += image->sizeInBytes();
+        }
+    }
+    for (const QImage& level : m_pyramid) {
+        bytes += level.sizeInBytes();
+    }
+    ImageMemoryGovernor::instance()->reportUsage(m_memoryConsumer, bytes);
+    ImageMemoryGovernor::instance()->reportUsage(m_tileMemoryConsumer, m_tileCache.stats().bytes);
+}
+
+void ImageViewerWidget::rebuildPyramid() {
+    m_pyramid.clear();
+    ++m_pyramidGeneration;
+    if (m_pyramidJob != 0) {
+        DecodeScheduler::instance()->cancel(m_pyramidJob); // A build already running is discarded on arrival
+        m_pyramidJob = 0;
+    }
+    // A progressive stand-in is replaced within moments, and small images are cheap to resample anyway
+    if (m_progressive || qMax(m_originalImage.width(), m_originalImage.height()) <= kPyramidMinimumExtent) return;
+
+    const QImage image = m_originalImage;
+    const quint64 generation = m_pyramidGeneration;
+    DecodeScheduler::Job job;
+    job.priority = DecodeScheduler::NeighborPrefetch; // Behind the visible image and its tiles, ahead of thumbnails
+    job.owner = this;
+    job.run = [this, image, generation](const QSharedPointer<MappedFile>&) {
+        const QVector<QImage> levels = buildPyramid(image);
+        QMetaObject::invokeMethod(this, [this, levels, generation]() {
+            if (generation != m_pyramidGeneration) return; // The image changed while building
+            m_pyramid = levels;
+            m_pyramidJob = 0;
+            reportMemoryUsage();
+            update();
+        }, Qt::QueuedConnection);
+    };
+    m_pyramidJob = DecodeScheduler::instance()->schedule(job);
 }
 
-void ImageViewerWidget::setImage(const QImage& image) {
+void ImageViewerWidget::noteInteraction() {
+    m_interacting = true;
+    m_settleTimer.start(); // Restarted by every event of the gesture
+}
+
+void ImageViewerWidget::requestRefine(const QImage& level, const RefineKey& key) {
+    if (m_refineJob != 0) {
+        if (m_refineRequestKey == key) return; // Already on the way
+        DecodeScheduler::instance()->cancel(m_refineJob); // A render already running is discarded on arrival
+    }
+    m_refineRequestKey = key;
+
+    DecodeScheduler::Job job;
+    job.priority = DecodeScheduler::VisibleImage;
+    job.owner = this;
+    job.run = [this, level, key](const QSharedPointer<MappedFile>&) {
+        const QImage refined = renderRefined(level, key.levelToDevice, key.deviceSize);
+        QMetaObject::invokeMethod(this, [this, refined, key]() {
+            if (!(key == m_refineRequestKey)) return; // Superseded while rendering
+            m_refineJob = 0;
+            m_refined = refined;
+            m_refined.setDevicePixelRatio(devicePixelRatioF());
+            m_refinedKey = key;
+            reportMemoryUsage();
+            update();
+        }, Qt::QueuedConnection);
+    };
+    m_refineJob = DecodeScheduler::instance()->schedule(job);
+}
+
+const QImage& ImageViewerWidget::imageForScale(qreal scale) const {
+    // Level n is 2^-n of the image: take the smallest one that is still magnified or
+    // at most halved, bilinear sampling stays alias-free down to 1/2
+    int level = 0;
+    for (qreal levelScale = scale; levelScale < 0.5 && level < m_pyramid.size(); levelScale *= 2) {
+        ++level;
+    }
+    return level == 0 ? m_originalImage : m_pyramid.at(level - 1);
+}
+
+void ImageViewerWidget::setImage(const QImage& image, const QSize& sourceSize, const QString& path) {
+    stopAnimation();
+    const QSize newSourceSize = sourceSize.isValid() ? sourceSize : image.size();
+    // Two files of the same size are not the same image
+    const bool keepView = m_progressive && !path.isEmpty() && path == m_progressivePath;
+    m_progressive = false;
+    m_progressivePath.clear();
     m_originalImageSource = image; // Store the pristine original image
     m_originalImage = image;       // Current base image for filter operations
+    m_sourceSize = newSourceSize;
+    m_fullResolutionRequested = false;
+    clearTiles();
+    if (keepView) {
+        // Final decode of the image shown progressively: zoom is relative to the
+        // source size, so the view the user may already have adjusted stays valid
+        rebuildPyramid();
+        reportMemoryUsage();
+        update();
+        requestFullResolutionIfNeeded();
+        return;
+    }
     resetTransformations();        // Reset all view transformations
-    applyTransformations();        // Apply transformations (which are now default)
+    rebuildPyramid();
+    reportMemoryUsage();
     fitImageToView();              // Fit to view initially
     update();                      // Request repaint
 }
 
+void ImageViewerWidget::setProgressiveImage(const QImage& image, const QSize& sourceSize, const QString& path) {
+    if (image.isNull()) return;
+    stopAnimation();
+    const QSize newSourceSize = sourceSize.isValid() ? sourceSize : image.size();
+    if (m_progressive && path == m_progressivePath) {
+        // A sharper stage of the same image, keep the view
+        m_originalImageSource = image;
+        m_originalImage = image;
+        rebuildPyramid();
+        reportMemoryUsage();
+        update();
+        return;
+    }
+    m_progressive = true; // Set first: fitting must not request full resolution for a stand-in
+    m_progressivePath = path;
+    m_originalImageSource = image;
+    m_originalImage = image;
+    m_sourceSize = newSourceSize;
+    m_fullResolutionRequested = false;
+    clearTiles();
+    resetTransformations();
+    rebuildPyramid();
+    reportMemoryUsage();
+    fitImageToView();
+    update();
+}
+
+void ImageViewerWidget::setFullResolutionImage(const QImage& image) {
+    if (image.isNull() || !isPreview()) return;
+    // A preview is never filtered: filters and undo snapshots wait for this upgrade
+    m_originalImageSource = image;
+    m_originalImage = image;
+    m_sourceSize = image.size();
+    rebuildPyramid();
+    reportMemoryUsage();
+    update();
+}
+
+void ImageViewerWidget::setTiledSource(const QSharedPointer<TiledImageSource>& source) {
+    stopAnimation();
+    clearTiles();
+    m_tiledSource = source;
+    reportMemoryUsage();
+    update();
+}
+
+void ImageViewerWidget::playAnimation(const QString& path) {
+    stopAnimation();
+    if (!m_originalImage.isNull()) {
+        m_animationPlayer.start(path);
+    }
+}
+
+void ImageViewerWidget::stopAnimation() {
+    m_animationPlayer.stop();
+    if (!m_animationFrame.isNull()) {
+        m_animationFrame = QImage();
+        update(); // Back to the still image
+    }
+}
+
+void ImageViewerWidget::clearTiles() {
+    m_tiledSource.reset();
+    m_tileCache.clear();
+    m_pendingTiles.clear();
+    ++m_tileGeneration;
+    QMutexLocker locker(&m_visibleTilesMutex);
+    m_visibleTiles.clear();
+}
+
+QImage ImageViewerWidget::currentImage() const {
+    if (m_originalImage.isNull()) return QImage();
+    // The view is never materialized (zooming a large image would mean a multi-GB copy);
+    // hand out the flipped and rotated m_originalImage, see the header for previews
+    if (OrthogonalTransform::isOrthogonal(m_rotationAngle)) {
+        // Every rotation the UI offers: a lossless pixel permutation, not a resample
+        return OrthogonalTransform::apply(m_originalImage, qRound(m_rotationAngle / 90.0), m_flippedHorizontal, m_flippedVertical);
+    }
+    // Flip and rotation in one resample; transformed() moves the result back to the origin
+    return m_originalImage.transformed(orientationTransform(), Qt::SmoothTransformation);
+}
+
 void ImageViewerWidget::setImageOnly(const QImage& image) {
     // This is for undo/redo: changes the base image data without resetting view transforms
+    stopAnimation();
     m_originalImage = image;
     // Don't touch m_originalImageSource here, as it's the very first loaded image
-    applyTransformations(); // Re-apply current transformations to the new image data
+    rebuildPyramid();
+    reportMemoryUsage(); // View transformations are applied when painting
     update();
 }
 
 void ImageViewerWidget::setZoomFactor(qreal factor) {
     m_zoomFactor = qMax(0.1, qMin(10.0, factor));
-    applyTransformations();
     update();
+    requestFullResolutionIfNeeded();
+}
+
+qreal ImageViewerWidget::sourceScale() const {
+    if (m_originalImage.isNull() || m_sourceSize.isEmpty()) return 1.0;
+    return (qreal)m_sourceSize.width() / m_originalImage.width();
+}
+
+void ImageViewerWidget::requestFullResolutionIfNeeded() {
+    // Past 1:1 on the preview, its pixels would be magnified: ask for the real ones.
+    // A progressive stand-in doesn't count, its decode is already on the way.
+    if (isPreview() && !m_progressive && !m_fullResolutionRequested && m_zoomFactor * sourceScale() > 1.001) {
+        m_fullResolutionRequested = true;
+        emit fullResolutionRequested();
+    }
 }
 
 // setRotationAngle, setFlipHorizontal, setFlipVertical, setScrollOffset are defined in header now
@@ -57,67 +418,45 @@ void ImageViewerWidget::rotate(int angle) {
     m_rotationAngle += angle;
     m_rotationAngle = fmod(m_rotationAngle, 360.0);
     if (m_rotationAngle < 0) m_rotationAngle += 360;
-    applyTransformations();
     update();
 }
 
 void ImageViewerWidget::flipHorizontal() {
     m_flippedHorizontal = !m_flippedHorizontal;
-    applyTransformations();
     update();
 }
 
 void ImageViewerWidget::flipVertical() {
     m_flippedVertical = !m_flippedVertical;
-    applyTransformations();
     update();
 }
 
 void ImageViewerWidget::applyGrayscale() {
-    if (m_originalImage.isNull()) return;
-    // Filters operate on m_originalImage. The result becomes the new m_originalImage.
-    QImage processedImage = m_originalImage.convertToFormat(QImage::Format_Grayscale8);
-    m_originalImage = processedImage;
-    applyTransformations(); // Re-apply view transforms to the new filtered image
-    update();
+    applyPointFilter(grayscaleFilter);
 }
 
 void ImageViewerWidget::applySepia() {
-    if (m_originalImage.isNull()) return;
-    QImage processedImage = m_originalImage;
-
-    // Convert to compatible format for pixel manipulation if needed
-    if (processedImage.format() == QImage::Format_Indexed8 || processedImage.format() == QImage::Format_Grayscale8) {
-        processedImage = processedImage.convertToFormat(QImage::Format_RGB32);
-    } else if (processedImage.format() != QImage::Format_RGB32 && processedImage.format() != QImage::Format_ARGB32 && processedImage.format() != QImage::Format_ARGB32_Premultiplied) {
-        processedImage = processedImage.convertToFormat(QImage::Format_ARGB32);
-    }
-
-    for (int y = 0; y < processedImage.height(); ++y) {
-        QRgb *line = reinterpret_cast<QRgb*>(processedImage.scanLine(y));
-        for (int x = 0; x < processedImage.width(); ++x) {
-            int r = qRed(line[x]);
-            int g = qGreen(line[x]);
-            int b = qBlue(line[x]);
-
-            int newR = qMin(255, static_cast<int>(0.393 * r + 0.769 * g + 0.189 * b));
-            int newG = qMin(255, static_cast<int>(0.349 * r + 0.686 * g + 0.168 * b));
-            int newB = qMin(255, static_cast<int>(0.272 * r + 0.534 * g + 0.131 * b));
-
-            line[x] = qRgb(newR, newG, newB);
-        }
-    }
-    m_originalImage = processedImage;
-    applyTransformations();
-    update();
+    applyPointFilter(sepiaFilter);
 }
 
 void ImageViewerWidget::applyNegative() {
+    applyPointFilter(negativeFilter);
+}
+
+void ImageViewerWidget::applyPointFilter(QImage (*filter)(const QImage&)) {
     if (m_originalImage.isNull()) return;
-    QImage processedImage = m_originalImage;
-    processedImage.invertPixels();
-    m_originalImage = processedImage;
-    applyTransformations();
+    stopAnimation(); // Filters apply to the still frame
+    // Filters operate on m_originalImage. The result becomes the new m_originalImage.
+    m_originalImage = filter(m_originalImage);
+    if (m_pyramidJob != 0) {
+        rebuildPyramid(); // The build in flight is still reducing the unfiltered image
+    } else {
+        // Filtering the levels costs a third of the image, rebuilding them would cost all of it
+        for (QImage& level : m_pyramid) {
+            level = filter(level);
+        }
+    }
+    reportMemoryUsage();
     update();
 }
 
@@ -127,9 +466,7 @@ void ImageViewerWidget::fitImageToView() {
         return;
     }
 
-    QTransform rotationTransform;
-    rotationTransform.rotate(m_rotationAngle);
-    QRectF transformedRect = rotationTransform.mapRect(m_originalImage.rect());
+    QRectF transformedRect = orientationTransform().mapRect(QRectF(QPointF(0, 0), QSizeF(m_sourceSize)));
 
     qreal widgetRatio = (qreal)width() / height();
     qreal imageRatio = transformedRect.width() / transformedRect.height();
@@ -141,67 +478,172 @@ void ImageViewerWidget::fitImageToView() {
     }
 
     m_zoomFactor = qMax(0.01, qMin(100.0, m_zoomFactor));
-    applyTransformations();
     update();
+    requestFullResolutionIfNeeded();
 }
 
-void ImageViewerWidget::applyTransformations() {
-    if (m_originalImage.isNull()) {
-        m_displayedImage = QImage();
-        return;
-    }
-
-    QImage tempImage = m_originalImage;
+void ImageViewerWidget::resetTransformations() {
+    m_zoomFactor = 1.0;
+    m_rotationAngle = 0.0;
+    m_flippedHorizontal = false;
+    m_flippedVertical = false;
+    m_scrollOffset = QPoint(0,0);
+}
 
-    // Apply Flip
-    if (m_flippedHorizontal) {
-        tempImage = tempImage.mirrored(true, false);
-    }
-    if (m_flippedVertical) {
-        tempImage = tempImage.mirrored(false, true);
+void ImageViewerWidget::paintEvent(QPaintEvent* event) {
+    QPainter painter(this);
+    painter.fillRect(event->rect(), palette().window());
+    if (m_originalImage.isNull() || m_sourceSize.isEmpty()) return;
+
+    if (!m_animationFrame.isNull()) {
+        painter.setTransform(viewTransform());
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        drawVisible(painter, m_animationFrame, event->rect());
+    } else if (m_tiledSource) {
+        paintTiled(painter, event->rect());
+    } else {
+        const qreal dpr = devicePixelRatioF();
+        const QImage& level = imageForScale(m_zoomFactor * sourceScale() * dpr);
+        RefineKey key;
+        key.levelToDevice = QTransform::fromScale(m_sourceSize.width() / qreal(level.width()), m_sourceSize.height() / qreal(level.height()))
+                          * viewTransform() * QTransform::fromScale(dpr, dpr);
+        key.levelKey = level.cacheKey();
+        key.deviceSize = size() * dpr;
+        if (!m_interacting && !m_refined.isNull() && m_refinedKey == key) {
+            painter.drawImage(QPointF(0, 0), m_refined);
+            return;
+        }
+        painter.setTransform(viewTransform());
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, !m_interacting);
+        drawVisible(painter, level, event->rect());
+        // Magnified views are already as good as bilinear gets; only shrinking gains from the box filter
+        if (!m_interacting && qAbs(key.levelToDevice.determinant()) < 0.998) requestRefine(level, key);
     }
+}
 
-    // Apply Rotation
+QTransform ImageViewerWidget::orientationTransform() const {
+    // Points are flipped first, then rotated
     QTransform transform;
     transform.rotate(m_rotationAngle);
-    tempImage = tempImage.transformed(transform, Qt::SmoothTransformation);
-
-    // Apply Zoom
-    int newWidth = qRound(tempImage.width() * m_zoomFactor);
-    int newHeight = qRound(tempImage.height() * m_zoomFactor);
+    transform.scale(m_flippedHorizontal ? -1 : 1, m_flippedVertical ? -1 : 1);
+    return transform;
+}
 
-    if (newWidth <= 0 || newHeight <= 0) {
-        m_displayedImage = QImage();
-        return;
+QTransform ImageViewerWidget::viewTransform() const {
+    // Points go through these steps left to right: center the image on the origin,
+    // flip and rotate, zoom, then move to the widget center plus the pan offset.
+    const QTransform transform = QTransform::fromTranslate(-m_sourceSize.width() / 2.0, -m_sourceSize.height() / 2.0)
+                               * orientationTransform()
+                               * QTransform::fromScale(m_zoomFactor, m_zoomFactor)
+                               * QTransform::fromTranslate(width() / 2.0 + m_scrollOffset.x(), height() / 2.0 + m_scrollOffset.y());
+    if (transform.type() <= QTransform::TxTranslate) {
+        // Unscaled and upright: keep pixels on the pixel grid, or 1:1 would be filtered to a blur
+        return QTransform::fromTranslate(qRound(transform.dx()), qRound(transform.dy()));
     }
-
-    m_displayedImage = tempImage.scaled(newWidth, newHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return transform;
 }
 
-void ImageViewerWidget::resetTransformations() {
-    m_zoomFactor = 1.0;
-    m_rotationAngle = 0.0;
-    m_flippedHorizontal = false;
-    m_flippedVertical = false;
-    m_scrollOffset = QPoint(0,0);
+void ImageViewerWidget::drawVisible(QPainter& painter, const QImage& image, const QRect& exposed) const {
+    const QRectF imageRect(QPointF(0, 0), QSizeF(m_sourceSize));
+    const QRectF visible = painter.transform().inverted().mapRect(QRectF(exposed)).intersected(imageRect);
+    if (visible.isEmpty() || image.isNull()) return;
+    // The same region in image pixels (a preview, overview or frame can be smaller than
+    // the source), grown by a pixel so the filter has its neighbours at the edges
+    const qreal scaleX = image.width() / imageRect.width();
+    const qreal scaleY = image.height() / imageRect.height();
+    const QRect pixels = QRectF(visible.left() * scaleX, visible.top() * scaleY, visible.width() * scaleX,
+                                visible.height() * scaleY).toAlignedRect().adjusted(-1, -1, 1, 1).intersected(image.rect());
+    const QRectF target(pixels.left() / scaleX, pixels.top() / scaleY, pixels.width() / scaleX, pixels.height() / scaleY);
+    // The raster engine samples only what lands inside the clip, no intermediate copy
+    painter.drawImage(target, image, QRectF(pixels));
 }
 
-void ImageViewerWidget::paintEvent(QPaintEvent* event) {
-    Q_UNUSED(event);
-    QPainter painter(this);
-    painter.fillRect(rect(), palette().window());
+void ImageViewerWidget::paintTiled(QPainter& painter, const QRect& exposed) {
+    const QTransform transform = viewTransform();
+    const QRectF imageRect(QPointF(0, 0), QSizeF(m_sourceSize));
+    painter.setTransform(transform);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+    // The overview is always drawn first; tiles refine it where they are ready
+    drawVisible(painter, imageForScale(m_zoomFactor * sourceScale() * devicePixelRatioF()), exposed);
+
+    // Tiles only apply while the overview would be magnified, and to the unfiltered image
+    const bool unfiltered = (m_originalImage.cacheKey() == m_originalImageSource.cacheKey());
+    if (!unfiltered || m_zoomFactor * sourceScale() <= 1.0) return;
+
+    const QRectF visible = transform.inverted().mapRect(QRectF(rect())).intersected(imageRect);
+    if (visible.isEmpty()) return;
+    const QSize tile = m_tiledSource->tileSize();
+    const int firstColumn = qMax(0, int(visible.left()) / tile.width());
+    const int lastColumn = qMin(m_tiledSource->columnCount() - 1, int(qCeil(visible.right()) - 1) / tile.width());
+    const int firstRow = qMax(0, int(visible.top()) / tile.height());
+    const int lastRow = qMin(m_tiledSource->rowCount() - 1, int(qCeil(visible.bottom()) - 1) / tile.height());
+    if ((lastColumn - firstColumn + 1) * (lastRow - firstRow + 1) > kMaxVisibleTiles) {
+        QMutexLocker locker(&m_visibleTilesMutex);
+        m_visibleTiles.clear(); // Let queued tiles be skipped
+        return;
+    }
+
+    QSet<QString> visibleKeys;
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            visibleKeys.insert(tileKey(column, row));
+        }
+    }
+    {
+        // Publish before queueing so workers don't skip tiles of this very frame
+        QMutexLocker locker(&m_visibleTilesMutex);
+        m_visibleTiles = visibleKeys;
+    }
 
-    if (!m_displayedImage.isNull()) {
-        int x = (width() - m_displayedImage.width()) / 2 + m_scrollOffset.x();
-        int y = (height() - m_displayedImage.height()) / 2 + m_scrollOffset.y();
-        painter.drawImage(x, y, m_displayedImage);
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            const QString key = tileKey(column, row);
+            QImage tileImage = m_tileCache.find(key);
+            if (!tileImage.isNull()) {
+                painter.drawImage(QRectF(m_tiledSource->tileRect(column, row)), tileImage);
+            } else {
+                requestTile(column, row, key);
+            }
+        }
     }
 }
 
+void ImageViewerWidget::requestTile(int column, int row, const QString& key) {
+    if (m_pendingTiles.contains(key)) return;
+    m_pendingTiles.insert(key);
+
+    QSharedPointer<TiledImageSource> source = m_tiledSource;
+    const quint64 generation = m_tileGeneration;
+    // No path: libtiff and the reader do their own partial reads, faulting in the whole file would be wasteful
+    DecodeScheduler::Job job;
+    job.priority = DecodeScheduler::VisibleImage;
+    job.owner = this;
+    job.run = [this, source, column, row, key, generation](const QSharedPointer<MappedFile>&) {
+        bool wanted;
+        {
+            QMutexLocker locker(&m_visibleTilesMutex);
+            wanted = m_visibleTiles.contains(key); // Scrolled away while queued?
+        }
+        QImage tileImage = wanted ? source->readTile(column, row) : QImage();
+        QMetaObject::invokeMethod(this, [this, key, tileImage, generation]() {
+            if (generation != m_tileGeneration) return; // Belongs to a previous image
+            m_pendingTiles.remove(key);
+            if (!tileImage.isNull()) {
+                m_tileCache.insert(key, tileImage);
+                reportMemoryUsage();
+                update();
+            }
+        }, Qt::QueuedConnection);
+    };
+    DecodeScheduler::instance()->schedule(job);
+}
+
 void ImageViewerWidget::wheelEvent(QWheelEvent* event) {
     if (m_originalImage.isNull()) return;
 
     if (event->modifiers() & Qt::ControlModifier) {
+        noteInteraction();
         if (event->angleDelta().y() > 0) {
             zoomIn();
         } else {
@@ -209,6 +651,7 @@ void ImageViewerWidget::wheelEvent(QWheelEvent* event) {
         }
         event->accept();
     } else {
+        noteInteraction();
         m_scrollOffset += event->pixelDelta().isNull() ? event->angleDelta() / 8 : event->pixelDelta();
         update();
         event->accept();
@@ -225,6 +668,7 @@ void ImageViewerWidget::mousePressEvent(QMouseEvent* event) {
 
 void ImageViewerWidget::mouseMoveEvent(QMouseEvent* event) {
     if (event->buttons() & Qt::LeftButton) {
+        noteInteraction();
         QPoint delta = event->pos() - m_lastMousePos;
         m_scrollOffset += delta;
         m_lastMousePos = event->pos();
@@ -10,31 +10,63 @@
 #include <QResizeEvent>
 #include <QTransform>
 #include <QPoint> // For QPoint
+#include <QSet>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QVector>
+#include "ImageCache.h"
+#include "TiledImageSource.h"
+#include "AnimationPlayer.h"
 
 class ImageViewerWidget : public QWidget {
     Q_OBJECT
 public:
     ImageViewerWidget(QWidget* parent = nullptr);
-
-    // Primary setter for new images (resets transformations)
-    void setImage(const QImage& image);
+    ~ImageViewerWidget();
+
+    // Primary setter for new images (resets transformations). sourceSize is the native
+    // size of the file when image is a reduced "decode for viewport" preview.
+    void setImage(const QImage& image, const QSize& sourceSize = QSize(), const QString& path = QString());
+    // Shows a low-resolution stand-in (embedded thumbnail, coarse decode) of path while
+    // the real decode is running. The following setImage() of the same path replaces it
+    // without resetting zoom or scroll.
+    void setProgressiveImage(const QImage& image, const QSize& sourceSize, const QString& path);
+    bool isProgressive() const { return m_progressive; }
+    // Swaps a preview for the full-resolution decode without touching the view state.
+    // Filters must not be applied to a preview; callers upgrade first.
+    void setFullResolutionImage(const QImage& image);
+    // Renders the current image from tiles of source when zoomed past its overview.
+    // The loaded image is kept as the overview; view state is preserved.
+    void setTiledSource(const QSharedPointer<TiledImageSource>& source);
+    // Plays path over the loaded image if it is animated; frames are drawn with
+    // the current view transform. Loading or editing an image stops playback.
+    void playAnimation(const QString& path);
+    void stopAnimation();
+    bool isAnimating() const { return m_animationPlayer.isPlaying(); }
     // Setter for undo/redo (changes image data but preserves transformations)
     void setImageOnly(const QImage& image); // NEW: For undo/redo to change image data without resetting view transforms
 
-    QImage currentImage() const { return m_displayedImage; }
+    // The loaded pixels flipped and rotated, without zoom. While isPreview() these are
+    // the reduced decode (or the overview in tiled mode), not the file's resolution:
+    // exporting callers upgrade to full resolution first.
+    QImage currentImage() const;
+    bool hasImage() const { return !m_originalImage.isNull(); }
     QImage getOriginalImage() const { return m_originalImage; } // Getter for current base image (after filters)
     QImage getOriginalImageSource() const { return m_originalImageSource; } // NEW: Getter for the pristine image when first loaded
+    QSize sourceSize() const { return m_sourceSize; } // Native pixel size of the loaded file
+    bool isPreview() const { return !m_originalImageSource.isNull() && m_originalImageSource.size() != m_sourceSize; }
 
     void setZoomFactor(qreal factor);
     qreal getZoomFactor() const { return m_zoomFactor; } // NEW: Getter for zoom factor
 
-    void setRotationAngle(qreal angle) { m_rotationAngle = angle; applyTransformations(); update(); } // NEW: Setter for rotation angle
+    void setRotationAngle(qreal angle) { m_rotationAngle = angle; update(); } // NEW: Setter for rotation angle
     qreal getRotationAngle() const { return m_rotationAngle; } // NEW: Getter for rotation angle
 
-    void setFlipHorizontal(bool flipped) { m_flippedHorizontal = flipped; applyTransformations(); update(); } // NEW: Setter for horizontal flip
+    void setFlipHorizontal(bool flipped) { m_flippedHorizontal = flipped; update(); } // NEW: Setter for horizontal flip
     bool getFlipHorizontal() const { return m_flippedHorizontal; } // NEW: Getter for horizontal flip
 
-    void setFlipVertical(bool flipped) { m_flippedVertical = flipped; applyTransformations(); update(); } // NEW: Setter for vertical flip
+    void setFlipVertical(bool flipped) { m_flippedVertical = flipped; update(); } // NEW: Setter for vertical flip
     bool getFlipVertical() const { return m_flippedVertical; } // NEW: Getter for vertical flip
 
     void setScrollOffset(const QPoint& offset) { m_scrollOffset = offset; update(); } // NEW: Setter for scroll offset
@@ -54,6 +86,10 @@ public:
 
     void fitImageToView();
 
+signals:
+    // Emitted once per image when zooming past 1:1 on a reduced-resolution preview
+    void fullResolutionRequested();
+
 protected:
     void paintEvent(QPaintEvent* event) override;
     void wheelEvent(QWheelEvent* event) override;
@@ -64,9 +100,51 @@ protected:
 
 
 private:
+    // Tiled rendering state (see setTiledSource)
+    QSharedPointer<TiledImageSource> m_tiledSource;
+    ImageCache m_tileCache;        // Decoded tiles, GUI thread only
+    QSet<QString> m_pendingTiles;  // Tiles queued on the DecodeScheduler
+    QSet<QString> m_visibleTiles;  // Read by workers to skip tiles scrolled away, guarded by m_visibleTilesMutex
+    QMutex m_visibleTilesMutex;
+    quint64 m_tileGeneration;      // Bumped whenever the tiled source changes
+
+    AnimationPlayer m_animationPlayer;
+    QImage m_animationFrame;       // Latest frame from m_animationPlayer, painted instead of m_originalImage
+
     QImage m_originalImageSource; // NEW: Stores the truly original image data as loaded from file
     QImage m_originalImage;       // The current base image data (after filters applied)
-    QImage m_displayedImage;      // The image after applying transformations (zoom, rotate, flip)
+    QSize m_sourceSize;           // Native size of the file; zoom factors are relative to it
+    bool m_fullResolutionRequested;
+    bool m_progressive;           // m_originalImage is a stand-in until the decode finishes
+    QString m_progressivePath;    // File the stand-in was decoded from
+    int m_memoryConsumer;         // ImageMemoryGovernor id for the buffers above
+    int m_tileMemoryConsumer;     // ImageMemoryGovernor id for m_tileCache, which can be evicted
+
+    // Power-of-two reductions of m_originalImage (m_pyramid[0] is half size, and so on),
+    // built in the background after load. Zoomed-out views resample from the nearest
+    // larger level, so their cost doesn't depend on the image size.
+    QVector<QImage> m_pyramid;
+    quint64 m_pyramidGeneration;  // Bumped whenever m_originalImage is replaced
+    quint64 m_pyramidJob;         // DecodeScheduler id of the queued or running build, 0 when none
+
+    // Two-phase rendering of zoomed-out views. While the wheel or a drag is active the
+    // view is sampled nearest-neighbour straight from the pyramid. Once input settles,
+    // the visible part is area-averaged on a worker and the result replaces it, until
+    // anything that changes its key.
+    struct RefineKey {
+        QTransform levelToDevice; // Pyramid level pixels to device pixels
+        qint64 levelKey = 0;      // cacheKey() of that level
+        QSize deviceSize;
+        bool operator==(const RefineKey& other) const {
+            return levelKey == other.levelKey && deviceSize == other.deviceSize && levelToDevice == other.levelToDevice;
+        }
+    };
+    bool m_interacting;
+    QTimer m_settleTimer;         // Ends the interaction once input has paused
+    QImage m_refined;             // Device-sized, drawn without a transform
+    RefineKey m_refinedKey;
+    RefineKey m_refineRequestKey;
+    quint64 m_refineJob;          // DecodeScheduler id of the queued or running render, 0 when none
 
     qreal m_zoomFactor;
     QPoint m_scrollOffset;
@@ -75,8 +153,29 @@ private:
     bool m_flippedVertical;
     QPoint m_lastMousePos;
 
-    void applyTransformations();
+    void reportMemoryUsage();
+    void rebuildPyramid();       // Drops the levels and schedules a build for m_originalImage
+    void noteInteraction();      // Switches to fast sampling until input settles
+    void requestRefine(const QImage& level, const RefineKey& key);
+    const QImage& imageForScale(qreal scale) const; // scale: device pixels per m_originalImage pixel
+    // Runs a per-pixel filter over m_originalImage and every pyramid level. Point
+    // filters (nearly) commute with the 2x2 averaging, so the levels stay valid.
+    void applyPointFilter(QImage (*filter)(const QImage&));
     void resetTransformations(); // NEW: Helper to reset viewer state
+    qreal sourceScale() const;   // Native pixels per pixel of m_originalImage
+    void requestFullResolutionIfNeeded();
+    // Flip, rotation and zoom are kept as view state only and composed into one
+    // transform, so every displayed pixel is a single resample of m_originalImage
+    // (or of a pyramid level) and nothing accumulates blur.
+    QTransform orientationTransform() const; // Flip, then rotation, about the origin
+    QTransform viewTransform() const; // Maps native image coordinates to widget coordinates
+    // Draws the part of image (covering the native image rect) that lands in exposed.
+    // painter carries viewTransform(), so only visible pixels are resampled and
+    // zoom, rotation and pan never produce a transformed copy of the image.
+    void drawVisible(QPainter& painter, const QImage& image, const QRect& exposed) const;
+    void clearTiles();
+    void paintTiled(QPainter& painter, const QRect& exposed);
+    void requestTile(int column, int row, const QString& key);
 };
 
 #endif // IMAGEVIEWERWIDGET_H
\ No newline at end of file
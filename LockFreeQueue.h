@@ -0,0 +1,61 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <QAtomicPointer>
+#include <QVector>
+#include <algorithm>
+
+// Multi-producer, single-consumer queue for handing results from worker threads
+// to the GUI thread. Producers push onto a Treiber stack with one CAS; the
+// consumer detaches the whole stack with one exchange and reverses it, so items
+// come out in push order. There is no single-item pop, which rules out ABA.
+template <typename T>
+class LockFreeQueue {
+public:
+    LockFreeQueue() : m_head(nullptr) {}
+    ~LockFreeQueue() { deleteList(m_head.fetchAndStoreAcquire(nullptr)); }
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    // Any thread. Returns true when the queue was empty, i.e. when the consumer
+    // needs to be woken; pushes onto a non-empty queue ride along with that wake-up.
+    bool push(const T& value) {
+        Node* node = new Node{value, nullptr};
+        Node* head = m_head.loadAcquire();
+        do {
+            node->next = head;
+        } while (!m_head.testAndSetOrdered(head, node, head));
+        return head == nullptr;
+    }
+
+    // Consumer thread only. Everything pushed so far, oldest first.
+    QVector<T> takeAll() {
+        Node* node = m_head.fetchAndStoreAcquire(nullptr);
+        QVector<T> values;
+        for (Node* it = node; it; it = it->next) values.append(it->value);
+        deleteList(node);
+        std::reverse(values.begin(), values.end());
+        return values;
+    }
+
+    bool isEmpty() const { return m_head.loadAcquire() == nullptr; }
+
+private:
+    struct Node {
+        T value;
+        Node* next;
+    };
+
+    static void deleteList(Node* node) {
+        while (node) {
+            Node* next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    QAtomicPointer<Node> m_head;
+};
+
+#endif // LOCKFREEQUEUE_H
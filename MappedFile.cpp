@@ -0,0 +1,129 @@
+#include "MappedFile.h"
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWeakPointer>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h> // For posix_madvise
+#endif
+
+namespace {
+// Mappings currently alive, so concurrent users of one file share a single mapping
+QMutex s_registryMutex;
+QHash<QString, QWeakPointer<MappedFile>> s_registry;
+
+// Files modified more recently than this may still be written to: read, don't map
+const qint64 kWriteSettleMs = 5000;
+
+bool isCurrent(const QSharedPointer<MappedFile>& file, const QFileInfo& fileInfo) {
+    return file && file->lastModified() == fileInfo.lastModified() && file->size() == fileInfo.size();
+}
+}
+
+QSharedPointer<MappedFile> MappedFile::open(const QString& path, QString* errorString) {
+    const QFileInfo fileInfo(path);
+    const QString key = fileInfo.absoluteFilePath();
+
+    {
+        QMutexLocker locker(&s_registryMutex);
+        QSharedPointer<MappedFile> existing = s_registry.value(key).toStrongRef();
+        if (isCurrent(existing, fileInfo)) return existing;
+    }
+
+    // Unlocked: the fallback reads the whole file, and one slow network or FUSE read
+    // must not hold up every other decoder. Two threads may load the same file; the
+    // second to finish adopts the first one's mapping.
+    QSharedPointer<MappedFile> file(new MappedFile(key));
+    if (!file->load(errorString)) {
+        return QSharedPointer<MappedFile>();
+    }
+
+    QMutexLocker locker(&s_registryMutex);
+    QSharedPointer<MappedFile> existing = s_registry.value(key).toStrongRef();
+    if (existing && existing->m_lastModified == file->m_lastModified && existing->m_size == file->m_size) {
+        return existing;
+    }
+    s_registry.insert(key, file);
+
+    // Drop registry entries whose mappings are gone
+    for (auto it = s_registry.begin(); it != s_registry.end();) {
+        it = it.value().isNull() ? s_registry.erase(it) : it + 1;
+    }
+    return file;
+}
+
+MappedFile::MappedFile(const QString& path)
+    : m_path(path), m_file(path), m_data(nullptr), m_size(0), m_mapped(false) {}
+
+MappedFile::~MappedFile() {
+    if (m_mapped) {
+        m_file.unmap(const_cast<uchar*>(m_data));
+    }
+}
+
+bool MappedFile::load(QString* errorString) {
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        if (errorString) *errorString = m_file.errorString();
+        return false;
+    }
+    m_lastModified = QFileInfo(m_file).lastModified();
+    m_size = m_file.size();
+
+    // A file still being written could be truncated under the mapping (SIGBUS), see the header
+    const bool settled = m_lastModified.msecsTo(QDateTime::currentDateTime()) > kWriteSettleMs;
+    uchar* mapped = (m_size > 0 && settled) ? m_file.map(0, m_size) : nullptr;
+    if (mapped) {
+        m_data = mapped;
+        m_mapped = true;
+    } else {
+        // Fresh files, pipes, some FUSE mounts, empty files: one buffered read is the next best thing
+        m_fallback = m_file.readAll();
+        m_data = reinterpret_cast<const uchar*>(m_fallback.constData());
+        m_size = m_fallback.size();
+        m_file.close();
+    }
+    return true;
+}
+
+void MappedFile::adviseSequential() const {
+#ifdef Q_OS_UNIX
+    if (m_mapped) {
+        // Let the kernel read ahead aggressively instead of faulting page by page
+        posix_madvise(const_cast<uchar*>(m_data), size_t(m_size), POSIX_MADV_SEQUENTIAL);
+    }
+#endif
+}
+
+MappedFileDevice::MappedFileDevice(const QSharedPointer<MappedFile>& file, QObject* parent)
+    : QIODevice(parent), m_mapping(file), m_cancelled(false) {
+    // Unbuffered: QIODevice's own read buffer would only add a copy
+    open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+qint64 MappedFileDevice::size() const {
+    return m_mapping ? m_mapping->size() : 0;
+}
+
+qint64 MappedFileDevice::readData(char* data, qint64 maxSize) {
+    if (!m_mapping) return -1;
+    if (m_isCancelled && m_isCancelled()) {
+        m_cancelled = true;
+        setErrorString("Decode cancelled");
+        return -1;
+    }
+    const qint64 available = m_mapping->size() - pos();
+    const qint64 count = qMin(maxSize, available);
+    if (count <= 0) return 0;
+    memcpy(data, m_mapping->data() + pos(), size_t(count));
+    return count;
+}
+
+qint64 MappedFileDevice::writeData(const char* data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1; // Read-only
+}
@@ -0,0 +1,84 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <QIODevice>
+#include <QSharedPointer>
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <functional>
+#include <limits>
+
+// Read-only view of a whole image file backed by QFile::map(). Decoders, the
+// thumbnailer and the metadata reader all go through open(), which hands out the
+// same mapping while any of them still holds it, so a file is mapped once and
+// read without further syscalls. Falls back to a single read() when the file
+// system does not support mapping.
+//
+// Truncating a mapped file makes the next access to the lost pages raise SIGBUS.
+// Files modified in the last few seconds (still being written into a watched
+// folder, or rewritten in place) are therefore read into memory rather than
+// mapped. Replacing a file by rename, as most savers do, is safe either way,
+// since the mapping keeps the old inode. What remains unguarded is another
+// program truncating an older file while it is being decoded.
+class MappedFile {
+public:
+    static QSharedPointer<MappedFile> open(const QString& path, QString* errorString = nullptr);
+    ~MappedFile();
+
+    QString path() const { return m_path; }
+    const uchar* data() const { return m_data; }
+    qint64 size() const { return m_size; }
+    bool isMapped() const { return m_mapped; }
+    QDateTime lastModified() const { return m_lastModified; }
+
+    // Hint for readers that will consume the whole file front to back (decoders).
+    // Header parsers leave it alone so only the pages they touch get read.
+    void adviseSequential() const;
+
+    // Zero-copy QByteArray over the mapping, valid while this object is alive.
+    // Empty for files of 2 GB and more, which a QByteArray cannot address.
+    QByteArray bytes() const {
+        if (m_size > std::numeric_limits<int>::max()) return QByteArray();
+        return QByteArray::fromRawData(reinterpret_cast<const char*>(m_data), int(m_size));
+    }
+
+private:
+    MappedFile(const QString& path);
+    bool load(QString* errorString);
+
+    QString m_path;
+    QFile m_file;
+    QByteArray m_fallback; // Used when mapping fails
+    const uchar* m_data;
+    qint64 m_size;
+    bool m_mapped;
+    QDateTime m_lastModified;
+};
+
+// Random-access QIODevice reading straight from a MappedFile, so QImageReader
+// consumes the mapping without an intermediate buffer. An optional cancel check
+// is polled on every read: returning true makes reads fail, which aborts the
+// decode in progress (used to drop decodes of images the user already left).
+class MappedFileDevice : public QIODevice {
+public:
+    explicit MappedFileDevice(const QSharedPointer<MappedFile>& file, QObject* parent = nullptr);
+
+    void setCancelCheck(const std::function<bool()>& isCancelled) { m_isCancelled = isCancelled; }
+    bool wasCancelled() const { return m_cancelled; }
+
+    bool isSequential() const override { return false; }
+    qint64 size() const override;
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 maxSize) override;
+
+private:
+    QSharedPointer<MappedFile> m_mapping;
+    std::function<bool()> m_isCancelled;
+    bool m_cancelled;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,171 @@
+#include "OrthogonalTransform.h"
+#include <QTransform>
+#include <QVector>
+#include <QtConcurrent>
+#include <QtMath>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+const int kTileSize = 64;                        // 64x64 32-bit pixels: 16 KB per tile, L1-sized
+const qint64 kParallelPixels = 4 * 1024 * 1024;  // Below this, threads cost more than they save
+
+struct Pixel24 {
+    uchar bytes[3];
+};
+
+// Output pixel (x, y) comes from source pixel (sourceX, sourceY):
+//   transpose == false: sourceX = x, sourceY = y
+//   transpose == true:  sourceX = y, sourceY = x
+// and afterwards sourceX is reversed when reverseX is set, sourceY when reverseY is.
+struct Mapping {
+    bool transpose;
+    bool reverseX;
+    bool reverseY;
+};
+
+template <typename T>
+const T* sourceRow(const QImage& source, int row) {
+    return reinterpret_cast<const T*>(source.constScanLine(row));
+}
+
+template <typename T>
+void copyRows(const QImage& source, QImage& target, const Mapping& mapping, int firstRow, int lastRow) {
+    const int width = target.width();
+    for (int y = firstRow; y < lastRow; ++y) {
+        const T* in = sourceRow<T>(source, mapping.reverseY ? source.height() - 1 - y : y);
+        T* out = reinterpret_cast<T*>(target.scanLine(y));
+        if (!mapping.reverseX) {
+            memcpy(out, in, width * sizeof(T));
+        } else {
+            for (int x = 0; x < width; ++x) {
+                out[x] = in[width - 1 - x];
+            }
+        }
+    }
+}
+
+template <typename T>
+void transposeTile(const QImage& source, QImage& target, const Mapping& mapping, int x0, int x1, int y0, int y1) {
+    const int sourceWidth = source.width();
+    const int sourceHeight = source.height();
+    for (int y = y0; y < y1; ++y) {
+        const int sourceX = mapping.reverseX ? sourceWidth - 1 - y : y;
+        T* out = reinterpret_cast<T*>(target.scanLine(y));
+        for (int x = x0; x < x1; ++x) {
+            out[x] = sourceRow<T>(source, mapping.reverseY ? sourceHeight - 1 - x : x)[sourceX];
+        }
+    }
+}
+
+#if defined(__SSE2__)
+// 32-bit pixels, 4x4 blocks in registers; the tile edges that don't fill a block go through the scalar loop
+void transposeTile32(const QImage& source, QImage& target, const Mapping& mapping, int x0, int x1, int y0, int y1) {
+    const int sourceWidth = source.width();
+    const int sourceHeight = source.height();
+    const int blockX1 = x0 + ((x1 - x0) & ~3);
+    const int blockY1 = y0 + ((y1 - y0) & ~3);
+    for (int y = y0; y < blockY1; y += 4) {
+        // Source columns of output rows y..y+3, as one 4-pixel load from the leftmost
+        const int sourceX = mapping.reverseX ? sourceWidth - 4 - y : y;
+        for (int x = x0; x < blockX1; x += 4) {
+            __m128i rows[4];
+            for (int k = 0; k < 4; ++k) {
+                const int sourceY = mapping.reverseY ? sourceHeight - 1 - (x + k) : x + k;
+                rows[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sourceRow<quint32>(source, sourceY) + sourceX));
+                if (mapping.reverseX) rows[k] = _mm_shuffle_epi32(rows[k], _MM_SHUFFLE(0, 1, 2, 3));
+            }
+            const __m128i low01 = _mm_unpacklo_epi32(rows[0], rows[1]);
+            const __m128i high01 = _mm_unpackhi_epi32(rows[0], rows[1]);
+            const __m128i low23 = _mm_unpacklo_epi32(rows[2], rows[3]);
+            const __m128i high23 = _mm_unpackhi_epi32(rows[2], rows[3]);
+            const __m128i columns[4] = {_mm_unpacklo_epi64(low01, low23), _mm_unpackhi_epi64(low01, low23),
+                                        _mm_unpacklo_epi64(high01, high23), _mm_unpackhi_epi64(high01, high23)};
+            for (int k = 0; k < 4; ++k) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(reinterpret_cast<quint32*>(target.scanLine(y + k)) + x), columns[k]);
+            }
+        }
+    }
+    if (blockX1 < x1) transposeTile<quint32>(source, target, mapping, blockX1, x1, y0, blockY1);
+    if (blockY1 < y1) transposeTile<quint32>(source, target, mapping, x0, x1, blockY1, y1);
+}
+#endif
+
+template <typename T>
+void transformBand(const QImage& source, QImage& target, const Mapping& mapping, int firstRow, int lastRow) {
+    if (!mapping.transpose) {
+        copyRows<T>(source, target, mapping, firstRow, lastRow);
+        return;
+    }
+    for (int y = firstRow; y < lastRow; y += kTileSize) {
+        for (int x = 0; x < target.width(); x += kTileSize) {
+            const int x1 = qMin(x + kTileSize, target.width());
+            const int y1 = qMin(y + kTileSize, lastRow);
+#if defined(__SSE2__)
+            if (sizeof(T) == 4) {
+                transposeTile32(source, target, mapping, x, x1, y, y1);
+                continue;
+            }
+#endif
+            transposeTile<T>(source, target, mapping, x, x1, y, y1);
+        }
+    }
+}
+
+void transformBand(const QImage& source, QImage& target, const Mapping& mapping, int firstRow, int lastRow) {
+    switch (source.depth()) {
+    case 8: transformBand<quint8>(source, target, mapping, firstRow, lastRow); break;
+    case 16: transformBand<quint16>(source, target, mapping, firstRow, lastRow); break;
+    case 24: transformBand<Pixel24>(source, target, mapping, firstRow, lastRow); break;
+    case 32: transformBand<quint32>(source, target, mapping, firstRow, lastRow); break;
+    case 64: transformBand<quint64>(source, target, mapping, firstRow, lastRow); break;
+    }
+}
+}
+
+bool OrthogonalTransform::isOrthogonal(qreal angle) {
+    return qFuzzyIsNull(std::fmod(angle, 90.0));
+}
+
+QImage OrthogonalTransform::apply(const QImage& image, int quarterTurns, bool flipHorizontal, bool flipVertical) {
+    quarterTurns = ((quarterTurns % 4) + 4) % 4;
+    if (image.isNull() || (quarterTurns == 0 && !flipHorizontal && !flipVertical)) return image;
+    const int depth = image.depth();
+    if (depth != 8 && depth != 16 && depth != 24 && depth != 32 && depth != 64) {
+        QTransform rotation;
+        rotation.rotate(quarterTurns * 90);
+        return image.mirrored(flipHorizontal, flipVertical).transformed(rotation);
+    }
+
+    // Clockwise quarter turns as permutations, then the flip folded in: flipping first
+    // reverses the same source axis the rotation reads from
+    static const Mapping rotations[4] = {{false, false, false}, {true, false, true}, {false, true, true}, {true, true, false}};
+    Mapping mapping = rotations[quarterTurns];
+    mapping.reverseX ^= flipHorizontal;
+    mapping.reverseY ^= flipVertical;
+
+    QImage target = mapping.transpose ? QImage(image.height(), image.width(), image.format())
+                                      : QImage(image.width(), image.height(), image.format());
+    if (target.isNull()) return QImage(); // Out of memory
+    target.setColorTable(image.colorTable());
+    target.setDevicePixelRatio(image.devicePixelRatio());
+    target.setDotsPerMeterX(mapping.transpose ? image.dotsPerMeterY() : image.dotsPerMeterX());
+    target.setDotsPerMeterY(mapping.transpose ? image.dotsPerMeterX() : image.dotsPerMeterY());
+
+    if (qint64(image.width()) * image.height() < kParallelPixels) {
+        transformBand(image, target, mapping, 0, target.height());
+        return target;
+    }
+    // Bands of whole tile rows, so no two threads write the same cache lines
+    const int bandRows = kTileSize * 4;
+    QVector<int> bands;
+    for (int row = 0; row < target.height(); row += bandRows) {
+        bands.append(row);
+    }
+    QtConcurrent::blockingMap(bands, [&image, &target, &mapping, bandRows](int firstRow) {
+        transformBand(image, target, mapping, firstRow, qMin(firstRow + bandRows, target.height()));
+    });
+    return target;
+}
@@ -0,0 +1,23 @@
+#ifndef ORTHOGONALTRANSFORM_H
+#define ORTHOGONALTRANSFORM_H
+
+#include <QImage>
+
+// Rotations by multiples of 90 degrees and flips, done as what they are: a pixel
+// permutation. Flip and rotation are composed into one pass over the image, so
+// the result is bit-exact and no intermediate copy is made.
+// Rows are copied straight or reversed. Transposing cases walk the image in
+// cache-sized tiles, with an SSE2 4x4 block transpose for 32-bit pixels. Large
+// images are split into bands across the global thread pool. Thread-safe.
+class OrthogonalTransform {
+public:
+    // True for angles (in degrees) that are a multiple of 90
+    static bool isOrthogonal(qreal angle);
+
+    // Mirrors image (before rotating, as QImage::mirrored() would), then rotates it
+    // clockwise by quarterTurns * 90 degrees. Formats below 8 bits per pixel fall
+    // back to QImage::mirrored() and QImage::transformed().
+    static QImage apply(const QImage& image, int quarterTurns, bool flipHorizontal, bool flipVertical);
+};
+
+#endif // ORTHOGONALTRANSFORM_H
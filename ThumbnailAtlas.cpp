@@ -0,0 +1,157 @@
+#include "ThumbnailAtlas.h"
+#include <QPainter>
+#include <cstring>
+
+namespace {
+const int kPageExtent = 1024;
+}
+
+ThumbnailAtlas::ThumbnailAtlas(const QSize& slotSize) : m_bytes(0), m_usedSlots(0) {
+    reset(slotSize);
+}
+
+void ThumbnailAtlas::reset(const QSize& slotSize) {
+    m_slotSize = slotSize;
+    m_slotsPerRow = qBound(2, kPageExtent / qMax(1, qMax(slotSize.width(), slotSize.height())), 16);
+    m_slotsPerPage = m_slotsPerRow * m_slotsPerRow;
+    m_pages.clear();
+    m_bytes = 0;
+    m_usedSlots = 0;
+}
+
+qint64 ThumbnailAtlas::pageBytes() const {
+    return qint64(m_slotSize.width()) * m_slotsPerRow * m_slotSize.height() * m_slotsPerRow * 4;
+}
+
+qint64 ThumbnailAtlas::slotBytes() const {
+    return pageBytes() / m_slotsPerPage;
+}
+
+QRect ThumbnailAtlas::slotRect(int index) const {
+    return QRect((index % m_slotsPerRow) * m_slotSize.width(), (index / m_slotsPerRow) * m_slotSize.height(),
+                 m_slotSize.width(), m_slotSize.height());
+}
+
+int ThumbnailAtlas::freeSlot() {
+    // Lowest free slot first, so live thumbnails stay packed into the first pages
+    for (int pageIndex = 0; pageIndex < m_pages.size(); ++pageIndex) {
+        Page& page = m_pages[pageIndex];
+        if (page.used == m_slotsPerPage) continue;
+        if (page.image.isNull()) {
+            page.image = QImage(m_slotSize * m_slotsPerRow, QImage::Format_ARGB32_Premultiplied);
+            m_bytes += pageBytes();
+        }
+        for (int index = 0; index < m_slotsPerPage; ++index) {
+            if (page.sizes.at(index).isEmpty()) return pageIndex * m_slotsPerPage + index;
+        }
+    }
+    Page page;
+    page.image = QImage(m_slotSize * m_slotsPerRow, QImage::Format_ARGB32_Premultiplied);
+    page.sizes.resize(m_slotsPerPage);
+    m_pages.append(page);
+    m_bytes += pageBytes();
+    return (m_pages.size() - 1) * m_slotsPerPage;
+}
+
+int ThumbnailAtlas::insert(const QImage& thumbnail) {
+    if (thumbnail.isNull() || m_slotSize.isEmpty()) return -1;
+    QImage source = thumbnail;
+    if (source.width() > m_slotSize.width() || source.height() > m_slotSize.height()) {
+        source = source.scaled(m_slotSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    if (source.format() != QImage::Format_ARGB32_Premultiplied) {
+        source = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    const int slot = freeSlot();
+    Page& page = m_pages[slot / m_slotsPerPage];
+    const QRect rect = slotRect(slot % m_slotsPerPage);
+    // Row by row into the page; no QPainter, no composition
+    const int rowBytes = source.width() * 4;
+    for (int y = 0; y < source.height(); ++y) {
+        memcpy(page.image.scanLine(rect.top() + y) + rect.left() * 4, source.constScanLine(y), rowBytes);
+    }
+    page.sizes[slot % m_slotsPerPage] = source.size();
+    ++page.used;
+    ++m_usedSlots;
+    return slot;
+}
+
+void ThumbnailAtlas::remove(int slot) {
+    if (slot < 0 || slot / m_slotsPerPage >= m_pages.size()) return;
+    Page& page = m_pages[slot / m_slotsPerPage];
+    QSize& size = page.sizes[slot % m_slotsPerPage];
+    if (size.isEmpty()) return;
+    size = QSize();
+    --page.used;
+    --m_usedSlots;
+}
+
+QSize ThumbnailAtlas::imageSize(int slot) const {
+    if (slot < 0 || slot / m_slotsPerPage >= m_pages.size()) return QSize();
+    return m_pages.at(slot / m_slotsPerPage).sizes.at(slot % m_slotsPerPage);
+}
+
+QImage ThumbnailAtlas::image(int slot) const {
+    const QSize size = imageSize(slot);
+    if (size.isEmpty()) return QImage();
+    const QRect rect = slotRect(slot % m_slotsPerPage);
+    return m_pages.at(slot / m_slotsPerPage).image.copy(QRect(rect.topLeft(), size));
+}
+
+void ThumbnailAtlas::draw(QPainter* painter, const QRect& target, int slot, qreal devicePixelRatio) const {
+    const QSize size = imageSize(slot);
+    if (size.isEmpty()) return;
+    const QSize logicalSize = (QSizeF(size) / devicePixelRatio).toSize();
+    const QSize drawn = size.scaled(target.size(), Qt::KeepAspectRatio).boundedTo(logicalSize);
+    const QRect targetRect(target.left() + (target.width() - drawn.width()) / 2,
+                           target.top() + (target.height() - drawn.height()) / 2, drawn.width(), drawn.height());
+    const QRect rect = slotRect(slot % m_slotsPerPage);
+    painter->drawImage(targetRect, m_pages.at(slot / m_slotsPerPage).image, QRect(rect.topLeft(), size));
+}
+
+void ThumbnailAtlas::releasePage(Page& page) {
+    if (page.image.isNull()) return;
+    page.image = QImage();
+    m_bytes -= pageBytes();
+}
+
+qint64 ThumbnailAtlas::compact(const std::function<void(int from, int to)>& moved) {
+    const qint64 before = m_bytes;
+    int target = 0; // Candidate free slot, only ever moves forward
+    for (int pageIndex = m_pages.size() - 1; pageIndex > 0; --pageIndex) {
+        Page& page = m_pages[pageIndex];
+        for (int index = 0; index < m_slotsPerPage && page.used > 0; ++index) {
+            if (page.sizes.at(index).isEmpty()) continue;
+            // Next free slot in an earlier page that still has its image
+            while (target < pageIndex * m_slotsPerPage) {
+                const Page& candidate = m_pages.at(target / m_slotsPerPage);
+                if (!candidate.image.isNull() && candidate.sizes.at(target % m_slotsPerPage).isEmpty()) break;
+                ++target;
+            }
+            if (target >= pageIndex * m_slotsPerPage) break;
+
+            const int from = pageIndex * m_slotsPerPage + index;
+            const QSize size = page.sizes.at(index);
+            const QRect sourceRect = slotRect(index);
+            Page& destination = m_pages[target / m_slotsPerPage];
+            const QRect targetRect = slotRect(target % m_slotsPerPage);
+            for (int y = 0; y < size.height(); ++y) {
+                memcpy(destination.image.scanLine(targetRect.top() + y) + targetRect.left() * 4,
+                       page.image.constScanLine(sourceRect.top() + y) + sourceRect.left() * 4, size.width() * 4);
+            }
+            destination.sizes[target % m_slotsPerPage] = size;
+            ++destination.used;
+            page.sizes[index] = QSize();
+            --page.used;
+            moved(from, target);
+        }
+    }
+    for (Page& page : m_pages) {
+        if (page.used == 0) releasePage(page);
+    }
+    while (!m_pages.isEmpty() && m_pages.last().image.isNull()) {
+        m_pages.removeLast();
+    }
+    return before - m_bytes;
+}
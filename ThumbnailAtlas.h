@@ -0,0 +1,66 @@
+#ifndef THUMBNAILATLAS_H
+#define THUMBNAILATLAS_H
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QVector>
+#include <functional>
+
+class QPainter;
+
+// Packs thumbnails into large atlas pages of fixed-size slots (about 1024x1024
+// pixels per page, one slot per thumbnail). A page is a single premultiplied QImage, so
+// thousands of thumbnails cost a handful of allocations, neighbouring rows sit
+// next to each other in memory, and painting is a sub-rect blit from the page.
+// Slots are addressed by an int id that stays valid until the slot is removed
+// or moved by compact(). GUI thread only.
+class ThumbnailAtlas {
+public:
+    explicit ThumbnailAtlas(const QSize& slotSize = QSize(128, 128));
+
+    void reset(const QSize& slotSize); // Drops every page
+    QSize slotSize() const { return m_slotSize; }
+
+    // Copies thumbnail into a free slot (scaled down first if it is larger than
+    // a slot) and returns the slot id, or -1 for a null image
+    int insert(const QImage& thumbnail);
+    void remove(int slot);
+
+    QSize imageSize(int slot) const;
+    QImage image(int slot) const; // Deep copy, for callers outside the paint path
+    // Draws the slot's thumbnail centered in target (logical pixels), never upscaled.
+    // Slots hold device pixels, devicePixelRatio maps them to target.
+    void draw(QPainter* painter, const QRect& target, int slot, qreal devicePixelRatio = 1.0) const;
+
+    // Moves thumbnails from the last pages into free slots of earlier ones and
+    // releases pages that end up empty. moved(from, to) is called for every slot
+    // that changed id. Returns the number of bytes released.
+    qint64 compact(const std::function<void(int from, int to)>& moved);
+
+    qint64 bytes() const { return m_bytes; }  // Resident page memory
+    qint64 slotBytes() const;                 // Memory one slot accounts for
+    int usedSlots() const { return m_usedSlots; }
+
+private:
+
+    struct Page {
+        QImage image;          // Null once every slot is free again
+        QVector<QSize> sizes;  // Thumbnail size per slot; empty means the slot is free
+        int used = 0;
+    };
+
+    int freeSlot();
+    QRect slotRect(int index) const;
+    qint64 pageBytes() const;
+    void releasePage(Page& page);
+
+    QSize m_slotSize;
+    int m_slotsPerRow;  // Pages stay near 4 MB whatever the slot size
+    int m_slotsPerPage;
+    QVector<Page> m_pages;
+    qint64 m_bytes;
+    int m_usedSlots;
+};
+
+#endif // THUMBNAILATLAS_H
@@ -0,0 +1,158 @@
+#include "ThumbnailCache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#ifdef Q_OS_UNIX
+#include <cstdio> // For rename(), which replaces the target atomically
+#endif
+
+namespace {
+const char* const kFailDirectory = "fail/imageview";
+
+QString flavorDirectory(ThumbnailCache::Flavor flavor) {
+    switch (flavor) {
+    case ThumbnailCache::Large: return QStringLiteral("large");
+    case ThumbnailCache::XLarge: return QStringLiteral("x-large");
+    default: return QStringLiteral("normal");
+    }
+}
+}
+
+ThumbnailCache::Flavor ThumbnailCache::flavorFor(const QSize& iconSize) {
+    const int extent = qMax(iconSize.width(), iconSize.height());
+    if (extent <= flavorSize(Normal)) return Normal;
+    return extent <= flavorSize(Large) ? Large : XLarge;
+}
+
+int ThumbnailCache::flavorSize(Flavor flavor) {
+    return 128 << int(flavor);
+}
+
+QString ThumbnailCache::cacheDirectory(Store store) {
+    // GenericCacheLocation honours $XDG_CACHE_HOME and falls back to ~/.cache;
+    // CacheLocation adds the organization and application names below it
+    const QStandardPaths::StandardLocation location =
+        store == Shared ? QStandardPaths::GenericCacheLocation : QStandardPaths::CacheLocation;
+    return QStandardPaths::writableLocation(location) + QStringLiteral("/thumbnails");
+}
+
+bool ThumbnailCache::ensureDirectories(Store store) {
+    const QString root = cacheDirectory(store);
+    const QFileDevice::Permissions ownerOnly = QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner;
+    for (const QString& subdirectory : {QStringLiteral("normal"), QStringLiteral("large"), QStringLiteral("x-large"), QString(kFailDirectory)}) {
+        const QString path = root + QLatin1Char('/') + subdirectory;
+        if (!QDir().mkpath(path)) {
+            qWarning() << "Could not create thumbnail directory:" << path;
+            return false;
+        }
+    }
+    // The spec requires 0700 on every level we may have created
+    for (const QString& path : {root, root + "/normal", root + "/large", root + "/x-large", root + "/fail", root + "/" + kFailDirectory}) {
+        QFile::setPermissions(path, ownerOnly);
+    }
+    return true;
+}
+
+QString ThumbnailCache::fileUri(const QString& imagePath) {
+    // The URI is hashed into the file name, so it must match g_filename_to_uri() byte for byte
+    // or other desktop apps never find our thumbnails (nor we theirs). GLib escapes the raw
+    // file name bytes, keeping unreserved characters and !$&'()*+,:=@/ (not ;).
+    const QByteArray path = QFile::encodeName(QFileInfo(imagePath).absoluteFilePath());
+    return QStringLiteral("file://") + QString::fromLatin1(path.toPercentEncoding("!$&'()*+,:=@/"));
+}
+
+QString ThumbnailCache::thumbnailPath(const QString& uri, const QString& subdirectory, Store store) {
+    const QByteArray md5 = QCryptographicHash::hash(uri.toUtf8(), QCryptographicHash::Md5).toHex();
+    return cacheDirectory(store) + QLatin1Char('/') + subdirectory + QLatin1Char('/') + QString::fromLatin1(md5) + QStringLiteral(".png");
+}
+
+QImage ThumbnailCache::load(const QString& imagePath, Flavor flavor, Store store) {
+    const QFileInfo source(imagePath);
+    const QString uri = fileUri(imagePath);
+    QImageReader reader(thumbnailPath(uri, flavorDirectory(flavor), store), "png");
+    if (!reader.canRead()) {
+        return QImage();
+    }
+    // The text chunks come before the pixel data, so a stale thumbnail is rejected without decoding it
+    if (reader.text(QStringLiteral("Thumb::URI")) != uri
+        || reader.text(QStringLiteral("Thumb::MTime")) != QString::number(source.lastModified().toSecsSinceEpoch())) {
+        return QImage();
+    }
+    return reader.read();
+}
+
+bool ThumbnailCache::save(const QString& imagePath, const QImage& thumbnail, Flavor flavor, const QSize& originalSize,
+                          Store store) {
+    const QFileInfo source(imagePath);
+    // Never thumbnail our own cache
+    if (thumbnail.isNull() || source.absoluteFilePath().startsWith(cacheDirectory(store) + QLatin1Char('/'))) {
+        return false;
+    }
+    const int size = flavorSize(flavor);
+    QImage image = (thumbnail.width() > size || thumbnail.height() > size)
+        ? thumbnail.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation) : thumbnail;
+
+    const QString uri = fileUri(imagePath);
+    image.setText(QStringLiteral("Thumb::URI"), uri);
+    image.setText(QStringLiteral("Thumb::MTime"), QString::number(source.lastModified().toSecsSinceEpoch()));
+    image.setText(QStringLiteral("Thumb::Size"), QString::number(source.size()));
+    if (originalSize.isValid()) {
+        image.setText(QStringLiteral("Thumb::Image::Width"), QString::number(originalSize.width()));
+        image.setText(QStringLiteral("Thumb::Image::Height"), QString::number(originalSize.height()));
+    }
+    image.setText(QStringLiteral("Software"), QStringLiteral("imageview"));
+    return writePng(thumbnailPath(uri, flavorDirectory(flavor), store), image);
+}
+
+bool ThumbnailCache::hasFailed(const QString& imagePath, Store store) {
+    const QString uri = fileUri(imagePath);
+    QImageReader reader(thumbnailPath(uri, kFailDirectory, store), "png");
+    return reader.canRead()
+        && reader.text(QStringLiteral("Thumb::MTime")) == QString::number(QFileInfo(imagePath).lastModified().toSecsSinceEpoch());
+}
+
+void ThumbnailCache::markFailed(const QString& imagePath, Store store) {
+    // The spec's failure entry: a 1x1 PNG carrying the same validation keys
+    QImage marker(1, 1, QImage::Format_ARGB32);
+    marker.fill(Qt::transparent);
+    const QString uri = fileUri(imagePath);
+    marker.setText(QStringLiteral("Thumb::URI"), uri);
+    marker.setText(QStringLiteral("Thumb::MTime"), QString::number(QFileInfo(imagePath).lastModified().toSecsSinceEpoch()));
+    marker.setText(QStringLiteral("Software"), QStringLiteral("imageview"));
+    writePng(thumbnailPath(uri, kFailDirectory, store), marker);
+}
+
+bool ThumbnailCache::writePng(const QString& targetPath, const QImage& image) {
+    // Write next to the target and rename into place, so readers in other
+    // processes never see a half-written file. QTemporaryFile creates it 0600.
+    QTemporaryFile temporary(QFileInfo(targetPath).absolutePath() + QStringLiteral("/imageview-XXXXXX.png"));
+    temporary.setAutoRemove(false);
+    if (!temporary.open()) {
+        return false;
+    }
+    QImageWriter writer(&temporary, "png");
+    const bool written = writer.write(image);
+    temporary.close();
+    const QString temporaryPath = temporary.fileName();
+    if (!written) {
+        QFile::remove(temporaryPath);
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    const bool renamed = ::rename(QFile::encodeName(temporaryPath).constData(), QFile::encodeName(targetPath).constData()) == 0;
+#else
+    QFile::remove(targetPath);
+    const bool renamed = QFile::rename(temporaryPath, targetPath);
+#endif
+    if (!renamed) {
+        QFile::remove(temporaryPath);
+    }
+    return renamed;
+}
@@ -0,0 +1,52 @@
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+// On-disk thumbnail cache following the freedesktop.org Thumbnail Managing
+// Standard, so thumbnails are shared with file managers and other viewers:
+// $XDG_CACHE_HOME/thumbnails/{normal,large,x-large}/<md5 of file URI>.png, validated
+// through the Thumb::URI and Thumb::MTime text chunks. Files are written to a
+// temporary name and renamed into place with 0600 permissions (0700 for the
+// directories). All functions are thread-safe.
+// With the shared cache turned off, the same layout lives in a private directory
+// under the application's own cache location, so size changes still avoid decodes.
+class ThumbnailCache {
+public:
+    enum Store {
+        Shared,  // $XDG_CACHE_HOME/thumbnails
+        Private  // <application cache>/thumbnails, seen by nobody else
+    };
+
+    // Ascending; each level is half the size of the next one
+    enum Flavor {
+        Normal, // 128x128
+        Large,  // 256x256
+        XLarge  // 512x512, 256 px icons on HiDPI screens
+    };
+
+    static Flavor flavorFor(const QSize& iconSize); // Smallest flavor that covers iconSize
+    static int flavorSize(Flavor flavor);
+
+    static QString cacheDirectory(Store store = Shared);
+    static bool ensureDirectories(Store store = Shared);
+
+    // Null image when there is no thumbnail or it is out of date
+    static QImage load(const QString& imagePath, Flavor flavor, Store store = Shared);
+    // thumbnail is scaled down to the flavor size if needed; originalSize is recorded when valid
+    static bool save(const QString& imagePath, const QImage& thumbnail, Flavor flavor, const QSize& originalSize = QSize(),
+                     Store store = Shared);
+
+    // Failure markers (thumbnails/fail/imageview/), so broken files are not decoded on every visit
+    static bool hasFailed(const QString& imagePath, Store store = Shared);
+    static void markFailed(const QString& imagePath, Store store = Shared);
+
+private:
+    static QString fileUri(const QString& imagePath);
+    static QString thumbnailPath(const QString& uri, const QString& subdirectory, Store store);
+    static bool writePng(const QString& targetPath, const QImage& image);
+};
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,143 @@
+#include "ThumbnailGenerator.h"
+#include <QAtomicInteger>
+#include <QBuffer>
+#include <QDebug>
+#include <QImageReader>
+#include <QtGlobal>
+#include <cmath>
+#include "ImageHeaderParser.h"
+#include "MappedFile.h"
+#include "ThumbnailCache.h"
+
+namespace {
+QAtomicInteger<int> s_cacheHits;
+QAtomicInteger<int> s_embeddedHits;
+QAtomicInteger<int> s_scaledDecodes;
+QAtomicInteger<int> s_failures;
+
+// Cameras letterbox 16:9 or 3:2 frames into a 4:3 preview; those bars must not end up in the gallery
+const double kMaxAspectDeviation = 0.02;
+
+QImage finish(const QImage& image, const QSize& targetSize) {
+    // Premultiplied is the format QPainter blits fastest in the gallery delegate
+    return image.scaled(targetSize, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+        .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+}
+
+QImage ThumbnailGenerator::generate(const QString& imagePath, const QSize& targetSize, bool useSharedCache,
+                                    ThumbnailCache::Flavor largestFlavor) {
+    const ThumbnailCache::Flavor flavor = ThumbnailCache::flavorFor(targetSize);
+    const ThumbnailCache::Store store = useSharedCache ? ThumbnailCache::Shared : ThumbnailCache::Private;
+    // A small PNG read instead of a full decode when we (or, shared, any desktop app) thumbnailed it before
+    QImage cached = ThumbnailCache::load(imagePath, flavor, store);
+    if (!cached.isNull()) {
+        s_cacheHits.fetchAndAddRelaxed(1);
+        return finish(cached, targetSize);
+    }
+    if (ThumbnailCache::hasFailed(imagePath, store)) {
+        s_failures.fetchAndAddRelaxed(1);
+        return QImage();
+    }
+
+    QSharedPointer<MappedFile> file = MappedFile::open(imagePath);
+    if (!file) {
+        s_failures.fetchAndAddRelaxed(1);
+        qWarning() << "Failed to load image for thumbnail:" << imagePath;
+        return QImage();
+    }
+
+    // Only the header pages are touched here; no sequential read-ahead yet
+    QSize originalSize;
+    QImage image = embeddedThumbnail(file->data(), file->size(), targetSize, &originalSize);
+    if (!image.isNull()) {
+        s_embeddedHits.fetchAndAddRelaxed(1);
+        // A 160x120 preview only makes a proper normal (128) thumbnail; larger flavors need a real decode
+        ThumbnailCache::save(imagePath, image, ThumbnailCache::Normal, originalSize, store);
+        return finish(image, targetSize);
+    }
+
+    // One decode at the top of the chain, every smaller level derived from it
+    const ThumbnailCache::Flavor top = qMax(flavor, largestFlavor);
+    file->adviseSequential();
+    MappedFileDevice device(file);
+    QImageReader reader(&device);
+    // Decode straight to the top flavor size (DCT scaling for JPEG) rather than full resolution
+    originalSize = reader.size();
+    const int topSize = ThumbnailCache::flavorSize(top);
+    if (originalSize.width() > topSize || originalSize.height() > topSize) {
+        reader.setScaledSize(originalSize.scaled(topSize, topSize, Qt::KeepAspectRatio));
+    }
+    image = reader.read();
+    if (image.isNull()) {
+        s_failures.fetchAndAddRelaxed(1);
+        ThumbnailCache::markFailed(imagePath, store);
+        qWarning() << "Failed to load image for thumbnail:" << imagePath;
+        return QImage();
+    }
+    s_scaledDecodes.fetchAndAddRelaxed(1);
+
+    QImage wanted = image;
+    QImage level = image;
+    for (int f = top; f >= ThumbnailCache::Normal; --f) {
+        const int size = ThumbnailCache::flavorSize(ThumbnailCache::Flavor(f));
+        if (level.width() > size || level.height() > size) {
+            // Halving from the previous level keeps each step a cheap, alias-free 2:1 reduction
+            level = level.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        ThumbnailCache::save(imagePath, level, ThumbnailCache::Flavor(f), originalSize, store);
+        if (f == flavor) wanted = level;
+    }
+    return finish(wanted, targetSize);
+}
+
+QImage ThumbnailGenerator::embeddedThumbnail(const uchar* data, qint64 size, const QSize& targetSize, QSize* originalSize) {
+    const ImageHeaderInfo header = ImageHeaderParser::parse(data, size);
+    if (!header.isValid() || header.thumbnailLength <= 0 || header.thumbnailOffset + header.thumbnailLength > size) {
+        return QImage();
+    }
+    // Only worth it when the preview fills the icon without upscaling
+    const QSize fitted = header.size.scaled(targetSize, Qt::KeepAspectRatio).boundedTo(header.size);
+
+    QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data + header.thumbnailOffset), int(header.thumbnailLength));
+    QBuffer buffer(&bytes);
+    QImageReader reader(&buffer, "jpeg");
+    const QSize previewSize = reader.size(); // From the preview's SOF, before decoding it
+    if (!previewSize.isValid() || previewSize.width() < fitted.width() || previewSize.height() < fitted.height()) {
+        return QImage();
+    }
+    const double imageAspect = double(header.size.width()) / header.size.height();
+    const double previewAspect = double(previewSize.width()) / previewSize.height();
+    if (std::abs(previewAspect / imageAspect - 1.0) > kMaxAspectDeviation) {
+        return QImage();
+    }
+    QImage preview = reader.read();
+    if (!preview.isNull()) {
+        *originalSize = header.size;
+    }
+    return preview;
+}
+
+ThumbnailGenerator::Statistics ThumbnailGenerator::statistics() {
+    Statistics stats;
+    stats.cacheHits = s_cacheHits.loadAcquire();
+    stats.embeddedHits = s_embeddedHits.loadAcquire();
+    stats.scaledDecodes = s_scaledDecodes.loadAcquire();
+    stats.failures = s_failures.loadAcquire();
+    return stats;
+}
+
+QString ThumbnailGenerator::statisticsSummary() {
+    const Statistics stats = statistics();
+    const int total = qMax(1, stats.total());
+    return QString("%1 thumbnails: %2 from cache, %3 from EXIF previews (%4%), %5 decoded, %6 failed")
+        .arg(stats.total()).arg(stats.cacheHits).arg(stats.embeddedHits)
+        .arg(100 * stats.embeddedHits / total).arg(stats.scaledDecodes).arg(stats.failures);
+}
+
+void ThumbnailGenerator::resetStatistics() {
+    s_cacheHits.storeRelease(0);
+    s_embeddedHits.storeRelease(0);
+    s_scaledDecodes.storeRelease(0);
+    s_failures.storeRelease(0);
+}
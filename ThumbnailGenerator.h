@@ -0,0 +1,50 @@
+#ifndef THUMBNAILGENERATOR_H
+#define THUMBNAILGENERATOR_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include "ThumbnailCache.h"
+
+// Produces gallery thumbnails, cheapest source first:
+//   1. the thumbnail cache: the shared freedesktop one, or a private one with the
+//      same layout when sharing is turned off,
+//   2. the JPEG preview embedded in the EXIF block (IFD1), when it covers the
+//      requested size and has the image's aspect ratio - a few KB read and a
+//      160x120 decode instead of the whole frame,
+//   3. a reduced-size decode of the image itself (DCT scaling for JPEG).
+// A decode produces the whole mip chain up to largestFlavor (128/256[/512],
+// each level halved from the one above) and stores every level in the cache,
+// so switching the gallery size or moving to a HiDPI screen later is a
+// cache read, not another decode. With JPEG DCT scaling, decoding for 512 px
+// costs about the same as decoding for 128 px (both are 1/8 scale for a camera frame).
+// There is no 64 px level: the spec's smallest flavor is 128, and 64 px icons
+// are scaled down from it on load.
+// Which path served each request is counted, so the hit rate of the fast paths
+// can be checked on real photo folders. All functions are thread-safe.
+class ThumbnailGenerator {
+public:
+    struct Statistics {
+        int cacheHits = 0;
+        int embeddedHits = 0;
+        int scaledDecodes = 0;
+        int failures = 0;
+
+        int total() const { return cacheHits + embeddedHits + scaledDecodes + failures; }
+    };
+
+    // targetSize is in device pixels. Null image when the file cannot be decoded.
+    // useSharedCache selects the freedesktop cache over the private one; see ThumbnailCache::Store.
+    static QImage generate(const QString& imagePath, const QSize& targetSize, bool useSharedCache,
+                           ThumbnailCache::Flavor largestFlavor = ThumbnailCache::Large);
+
+    static Statistics statistics();
+    static QString statisticsSummary(); // One line, for logs
+    static void resetStatistics();
+
+private:
+    // The EXIF preview scaled to targetSize, or a null image when there is none or it is too small
+    static QImage embeddedThumbnail(const uchar* data, qint64 size, const QSize& targetSize, QSize* originalSize);
+};
+
+#endif // THUMBNAILGENERATOR_H
@@ -0,0 +1,177 @@
+#include "TiledImageSource.h"
+#include "MappedFile.h"
+#include <QDebug>
+#include <QImageReader>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPainter>
+
+#ifdef HAVE_LIBTIFF
+#include <QtEndian>
+#include <tiffio.h>
+#endif
+
+namespace {
+
+const qint64 kTilingThresholdPixels = 100 * 1000 * 1000; // ~400 MB as ARGB32
+const int kVirtualTileSize = 512;
+const int kOverviewBandRows = 256;
+
+#ifdef HAVE_LIBTIFF
+// Tiled, striped and pyramidal TIFF through libtiff's RGBA interface, which can
+// decode an arbitrary rectangle and only touches the tiles/strips it overlaps.
+class TiffTiledImageSource : public TiledImageSource {
+public:
+    static TiledImageSource* create(const QString& path) {
+        TIFF* tif = TIFFOpen(QFile::encodeName(path).constData(), "r");
+        if (!tif) return nullptr;
+        char message[1024];
+        if (!TIFFRGBAImageOK(tif, message)) {
+            qDebug() << "libtiff cannot decode" << path << "as RGBA:" << message;
+            TIFFClose(tif);
+            return nullptr;
+        }
+        return new TiffTiledImageSource(tif);
+    }
+
+    ~TiffTiledImageSource() override { TIFFClose(m_tif); }
+
+    QSize size() const override { return m_size; }
+    QSize tileSize() const override { return m_tileSize; }
+
+    QImage readTile(int column, int row) override {
+        QMutexLocker locker(&m_mutex); // A TIFF handle is not thread-safe
+        // Directory 0 stays selected (TIFFOpen reads it, overview() switches back);
+        // re-selecting it per tile would re-read and re-parse the IFD every time
+        return readRegion(tileRect(column, row));
+    }
+
+    QImage overview(const QSize& maxSize) override {
+        QMutexLocker locker(&m_mutex);
+        const QSize target = m_size.scaled(maxSize, Qt::KeepAspectRatio).boundedTo(m_size);
+
+        // Pyramidal TIFFs carry reduced-resolution pages: use the smallest one that is big enough
+        const tdir_t directories = TIFFNumberOfDirectories(m_tif);
+        for (tdir_t dir = directories - 1; dir > 0; --dir) {
+            uint32_t subfileType = 0, width = 0, height = 0;
+            if (!TIFFSetDirectory(m_tif, dir)) continue;
+            TIFFGetField(m_tif, TIFFTAG_SUBFILETYPE, &subfileType);
+            TIFFGetField(m_tif, TIFFTAG_IMAGEWIDTH, &width);
+            TIFFGetField(m_tif, TIFFTAG_IMAGELENGTH, &height);
+            if ((subfileType & FILETYPE_REDUCEDIMAGE) && int(width) >= target.width() && int(height) >= target.height()) {
+                QImage page = readRegion(QRect(0, 0, int(width), int(height)));
+                TIFFSetDirectory(m_tif, 0);
+                return page.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+        }
+        TIFFSetDirectory(m_tif, 0);
+
+        // Otherwise stream full-width bands and downscale each into place
+        QImage result(target, QImage::Format_ARGB32_Premultiplied);
+        result.fill(Qt::transparent);
+        QPainter painter(&result);
+        const qreal scale = qreal(target.height()) / m_size.height();
+        for (int y = 0; y < m_size.height(); y += kOverviewBandRows) {
+            QImage band = readRegion(QRect(0, y, m_size.width(), kOverviewBandRows).intersected(QRect(QPoint(0, 0), m_size)));
+            if (band.isNull()) break;
+            const int top = qRound(y * scale);
+            const int bottom = qRound((y + band.height()) * scale);
+            if (bottom > top) {
+                painter.drawImage(0, top, band.scaled(target.width(), bottom - top, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+            }
+        }
+        return result;
+    }
+
+private:
+    explicit TiffTiledImageSource(TIFF* tif) : m_tif(tif) {
+        uint32_t width = 0, height = 0;
+        TIFFGetField(m_tif, TIFFTAG_IMAGEWIDTH, &width);
+        TIFFGetField(m_tif, TIFFTAG_IMAGELENGTH, &height);
+        m_size = QSize(int(width), int(height));
+
+        // Follow the file's own tiling when it has a sensible one, so each of our
+        // tiles decodes whole TIFF tiles; striped files get square virtual tiles.
+        uint32_t tileWidth = 0, tileHeight = 0;
+        if (TIFFIsTiled(m_tif) && TIFFGetField(m_tif, TIFFTAG_TILEWIDTH, &tileWidth)
+            && TIFFGetField(m_tif, TIFFTAG_TILELENGTH, &tileHeight) && tileWidth >= 256 && tileHeight >= 256) {
+            m_tileSize = QSize(int(tileWidth), int(tileHeight));
+        } else {
+            m_tileSize = QSize(kVirtualTileSize, kVirtualTileSize);
+        }
+    }
+
+    // Caller holds m_mutex and has selected the directory to read from
+    QImage readRegion(const QRect& region) {
+        char message[1024];
+        TIFFRGBAImage img;
+        if (region.isEmpty() || !TIFFRGBAImageBegin(&img, m_tif, 0, message)) {
+            return QImage();
+        }
+        img.req_orientation = ORIENTATION_TOPLEFT;
+        img.row_offset = region.y();
+        img.col_offset = region.x();
+
+        // libtiff packs R | G << 8 | B << 16 | A << 24 with associated alpha,
+        // which is RGBA8888 byte order on little-endian machines.
+        QImage image(region.size(), QImage::Format_RGBA8888_Premultiplied);
+        const bool ok = !image.isNull()
+            && TIFFRGBAImageGet(&img, reinterpret_cast<uint32_t*>(image.bits()), uint32_t(region.width()), uint32_t(region.height()));
+        TIFFRGBAImageEnd(&img);
+        if (!ok) return QImage();
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+        for (int y = 0; y < image.height(); ++y) {
+            quint32* line = reinterpret_cast<quint32*>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) line[x] = qbswap(line[x]);
+        }
+#endif
+        return image;
+    }
+
+    TIFF* m_tif;
+    QMutex m_mutex;
+    QSize m_size;
+    QSize m_tileSize;
+};
+#endif // HAVE_LIBTIFF
+
+} // namespace
+
+bool TiledImageSource::shouldUseTiles(const QSize& imageSize) {
+    return imageSize.isValid() && qint64(imageSize.width()) * imageSize.height() > kTilingThresholdPixels;
+}
+
+QSharedPointer<TiledImageSource> TiledImageSource::open(const QString& path) {
+#ifdef HAVE_LIBTIFF
+    QSharedPointer<MappedFile> file = MappedFile::open(path);
+    if (!file) return QSharedPointer<TiledImageSource>();
+    MappedFileDevice device(file);
+    QImageReader reader(&device);
+    const QByteArray format = reader.format();
+    if (format == "tif" || format == "tiff") {
+        if (TiledImageSource* source = TiffTiledImageSource::create(path)) {
+            return QSharedPointer<TiledImageSource>(source);
+        }
+    }
+#else
+    Q_UNUSED(path);
+#endif
+    // Nothing else: QImageReader's ClipRect (JPEG included) still decodes every scanline
+    // above the clip, so each tile would cost a decode of the image down to it.
+    // Those formats get a DCT-scaled overview from decodeImage() instead.
+    return QSharedPointer<TiledImageSource>();
+}
+
+QRect TiledImageSource::tileRect(int column, int row) const {
+    const QSize tile = tileSize();
+    return QRect(column * tile.width(), row * tile.height(), tile.width(), tile.height())
+        .intersected(QRect(QPoint(0, 0), size()));
+}
+
+int TiledImageSource::columnCount() const {
+    return (size().width() + tileSize().width() - 1) / tileSize().width();
+}
+
+int TiledImageSource::rowCount() const {
+    return (size().height() + tileSize().height() - 1) / tileSize().height();
+}
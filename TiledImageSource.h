@@ -0,0 +1,40 @@
+#ifndef TILEDIMAGESOURCE_H
+#define TILEDIMAGESOURCE_H
+
+#include <QImage>
+#include <QRect>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+
+// Random-access view of an image too large to hold as one QImage. Only the tiles
+// intersecting the viewport get decoded; zoomed-out views use a screen-sized
+// overview that is built without ever materializing the whole image.
+//
+// Implementations are thread-safe: tiles are decoded on worker threads.
+class TiledImageSource {
+public:
+    virtual ~TiledImageSource() {}
+
+    // Returns a tiled source for path, or null when its format has no random-access
+    // decode path. Only tiled/striped TIFF read through libtiff has one; other formats
+    // above shouldUseTiles() are shown from a reduced decode and never loaded whole.
+    static QSharedPointer<TiledImageSource> open(const QString& path);
+
+    // Images above this many pixels are decoded through a tiled source when possible
+    static bool shouldUseTiles(const QSize& imageSize);
+
+    virtual QSize size() const = 0;
+    virtual QSize tileSize() const = 0;
+
+    QRect tileRect(int column, int row) const;
+    int columnCount() const;
+    int rowCount() const;
+
+    // Decodes the tile at (column, row); edge tiles are cropped to the image
+    virtual QImage readTile(int column, int row) = 0;
+    // Whole image scaled to fit maxSize, decoded band by band with bounded memory
+    virtual QImage overview(const QSize& maxSize) = 0;
+};
+
+#endif // TILEDIMAGESOURCE_H
@@ -0,0 +1,295 @@
+// Thumbnail pipeline benchmark.
+//
+// Generates a synthetic corpus (JPEG, PNG and TIFF at a few frame sizes), then
+// thumbnails it through DecodeScheduler + ThumbnailGenerator exactly like the
+// gallery does, and reports per pass:
+//   - throughput (thumbnails per second of wall time),
+//   - p50/p99 latency of one ThumbnailGenerator::generate() call,
+//   - peak RSS of the process so far,
+//   - which pipeline path served the requests (cache, EXIF preview, decode).
+// A cold pass starts from an empty thumbnail cache with the corpus dropped from
+// the page cache (posix_fadvise, Linux only; without root this is the closest we
+// get to a cold disk). A warm pass repeats it with the cache filled by the cold
+// one. The cold pass is then repeated for every thread count.
+//
+// The thumbnail cache is redirected to a temporary directory, so running the
+// benchmark never touches ~/.cache/thumbnails.
+//
+// Synthetic JPEGs carry no EXIF preview, so the embedded-thumbnail fast path is
+// not exercised; point --corpus at a folder of camera JPEGs to measure it.
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QImageWriter>
+#include <QRandomGenerator>
+#include <QSemaphore>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include "DecodeScheduler.h"
+#include "ThumbnailCache.h"
+#include "ThumbnailGenerator.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+namespace {
+
+struct PassResult {
+    QVector<qint64> latenciesNs; // One per file, generate() only (queueing excluded)
+    qint64 wallNs = 0;
+    int failures = 0;
+};
+
+QTextStream& out() {
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+// Smooth gradients with a little noise: compresses roughly like a photo,
+// unlike flat colour (too small) or pure noise (too large).
+QImage syntheticImage(const QSize& size, quint32 seed) {
+    QImage image(size, QImage::Format_RGB32);
+    QRandomGenerator random(seed);
+    const double phase = random.bounded(628) / 100.0;
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        const double v = double(y) / size.height();
+        for (int x = 0; x < size.width(); ++x) {
+            const double u = double(x) / size.width();
+            const int noise = int(random.bounded(16)) - 8;
+            const int r = int(255 * u) + noise;
+            const int g = int(127.5 + 127.5 * std::sin(6.0 * (u + v) + phase)) + noise;
+            const int b = int(255 * v) + noise;
+            line[x] = qRgb(qBound(0, r, 255), qBound(0, g, 255), qBound(0, b, 255));
+        }
+    }
+    return image;
+}
+
+QStringList generateCorpus(const QString& directory, int countPerKind) {
+    const QList<QSize> sizes = {QSize(640, 480), QSize(2000, 1500), QSize(6000, 4000)};
+    QList<QByteArray> formats = {"jpg", "png"};
+    if (QImageWriter::supportedImageFormats().contains("tiff")) {
+        formats.append("tiff");
+    } else {
+        out() << "No TIFF image format plugin, corpus is JPEG and PNG only\n";
+    }
+
+    QDir().mkpath(directory);
+    QStringList files;
+    quint32 seed = 1;
+    for (const QSize& size : sizes) {
+        // One source frame per size and index, written in every format
+        for (int index = 0; index < countPerKind; ++index, ++seed) {
+            QImage image;
+            for (const QByteArray& format : formats) {
+                const QString path = QStringLiteral("%1/%2x%3_%4.%5").arg(directory).arg(size.width())
+                                         .arg(size.height()).arg(index, 3, 10, QLatin1Char('0')).arg(QString::fromLatin1(format));
+                if (!QFile::exists(path)) {
+                    if (image.isNull()) image = syntheticImage(size, seed);
+                    QImageWriter writer(path, format);
+                    if (format == "jpg") writer.setQuality(90);
+                    if (!writer.write(image)) {
+                        out() << "Could not write " << path << ": " << writer.errorString() << "\n";
+                        continue;
+                    }
+                }
+                files.append(path);
+            }
+        }
+        out() << "Corpus: " << size.width() << "x" << size.height() << " ready\n";
+        out().flush();
+    }
+    return files;
+}
+
+QStringList existingCorpus(const QString& directory) {
+    QStringList files;
+    QDirIterator iterator(directory, {QStringLiteral("*.jpg"), QStringLiteral("*.jpeg"), QStringLiteral("*.png"),
+                                      QStringLiteral("*.tif"), QStringLiteral("*.tiff")},
+                          QDir::Files, QDirIterator::Subdirectories);
+    while (iterator.hasNext()) {
+        files.append(iterator.next());
+    }
+    files.sort();
+    return files;
+}
+
+void dropThumbnailCache() {
+    QDir(ThumbnailCache::cacheDirectory()).removeRecursively();
+    ThumbnailCache::ensureDirectories();
+}
+
+void dropPageCache(const QStringList& files) {
+#ifdef Q_OS_LINUX
+    for (const QString& path : files) {
+        QFile file(path);
+        if (file.open(QIODevice::ReadOnly)) {
+            posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+        }
+    }
+#else
+    Q_UNUSED(files);
+#endif
+}
+
+qint64 peakRssKb() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+PassResult runPass(const QStringList& files, const QSize& targetSize, ThumbnailCache::Flavor largestFlavor) {
+    PassResult result;
+    result.latenciesNs.resize(files.size());
+    QAtomicInt failures(0);
+    QSemaphore done;
+    int owner = 0;
+
+    ThumbnailGenerator::resetStatistics();
+    QElapsedTimer wall;
+    wall.start();
+    for (int index = 0; index < files.size(); ++index) {
+        DecodeScheduler::Job job;
+        job.priority = DecodeScheduler::OffscreenThumbnail;
+        job.owner = &owner;
+        // No job.path, as in the gallery: the generator reads only what it needs
+        const QString path = files.at(index);
+        qint64* latency = &result.latenciesNs[index];
+        job.run = [path, targetSize, largestFlavor, latency, &failures, &done](const QSharedPointer<MappedFile>&) {
+            QElapsedTimer timer;
+            timer.start();
+            const QImage thumbnail = ThumbnailGenerator::generate(path, targetSize, true, largestFlavor);
+            *latency = timer.nsecsElapsed();
+            if (thumbnail.isNull()) failures.fetchAndAddRelaxed(1);
+            done.release();
+        };
+        job.dropped = [&done]() { done.release(); };
+        DecodeScheduler::instance()->schedule(job);
+    }
+    done.acquire(files.size());
+    result.wallNs = wall.nsecsElapsed();
+    result.failures = failures.loadAcquire();
+    return result;
+}
+
+double percentileMs(QVector<qint64> values, double percentile) {
+    if (values.isEmpty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    const int rank = qBound(0, int(std::ceil(percentile * values.size())) - 1, values.size() - 1);
+    return values.at(rank) / 1e6;
+}
+
+void report(const QString& label, int threads, const PassResult& result) {
+    const int count = result.latenciesNs.size();
+    const double seconds = result.wallNs / 1e9;
+    out() << qSetFieldWidth(6) << label << qSetFieldWidth(0) << "  threads " << qSetFieldWidth(2) << threads
+          << qSetFieldWidth(0) << "  " << QString::number(seconds > 0 ? count / seconds : 0.0, 'f', 1) << " thumbs/s"
+          << "  p50 " << QString::number(percentileMs(result.latenciesNs, 0.50), 'f', 2) << " ms"
+          << "  p99 " << QString::number(percentileMs(result.latenciesNs, 0.99), 'f', 2) << " ms"
+          << "  peak RSS " << peakRssKb() / 1024 << " MB";
+    if (result.failures > 0) out() << "  failures " << result.failures;
+    out() << "\n    " << ThumbnailGenerator::statisticsSummary() << "\n";
+    out().flush();
+}
+
+QList<int> defaultThreadCounts() {
+    QList<int> counts;
+    const int ideal = qMax(1, QThread::idealThreadCount() - 1);
+    for (int threads = 1; threads < ideal; threads *= 2) {
+        counts.append(threads);
+    }
+    counts.append(ideal);
+    return counts;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("thumbnailbench"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measures the imageview thumbnail pipeline on a synthetic corpus."));
+    parser.addHelpOption();
+    const QCommandLineOption corpusOption(QStringLiteral("corpus"),
+        QStringLiteral("Image directory. Generated when missing or empty; an existing corpus is used as is."), QStringLiteral("dir"));
+    const QCommandLineOption countOption(QStringLiteral("count"),
+        QStringLiteral("Generated files per size and format (default 8)."), QStringLiteral("n"), QStringLiteral("8"));
+    const QCommandLineOption sizeOption(QStringLiteral("size"),
+        QStringLiteral("Thumbnail size in pixels (default 128)."), QStringLiteral("px"), QStringLiteral("128"));
+    const QCommandLineOption threadsOption(QStringLiteral("threads"),
+        QStringLiteral("Comma-separated thumbnail thread counts (default 1,2,4,... up to the core count - 1)."), QStringLiteral("list"));
+    parser.addOptions({corpusOption, countOption, sizeOption, threadsOption});
+    parser.process(app);
+
+    // Before the first ThumbnailCache call; GenericCacheLocation follows $XDG_CACHE_HOME
+    QTemporaryDir cacheHome;
+    if (!cacheHome.isValid()) {
+        out() << "Could not create a temporary cache directory\n";
+        return 1;
+    }
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(cacheHome.path()));
+
+    QTemporaryDir generatedCorpus;
+    QString corpusDirectory = parser.value(corpusOption);
+    if (corpusDirectory.isEmpty()) corpusDirectory = generatedCorpus.path();
+    QStringList files = existingCorpus(corpusDirectory);
+    if (files.isEmpty()) files = generateCorpus(corpusDirectory, qMax(1, parser.value(countOption).toInt()));
+    if (files.isEmpty()) {
+        out() << "No images in " << corpusDirectory << "\n";
+        return 1;
+    }
+
+    const int size = qBound(16, parser.value(sizeOption).toInt(), ThumbnailCache::flavorSize(ThumbnailCache::XLarge));
+    const QSize targetSize(size, size);
+    // The gallery decodes up to its largest icon size once and caches every level below
+    const ThumbnailCache::Flavor largestFlavor = ThumbnailCache::flavorFor(QSize(256, 256).expandedTo(targetSize));
+
+    QList<int> threadCounts;
+    for (const QString& value : parser.value(threadsOption).split(QLatin1Char(','))) {
+        if (value.toInt() > 0) threadCounts.append(value.toInt()); // Also skips empty parts
+    }
+    if (threadCounts.isEmpty()) threadCounts = defaultThreadCounts();
+
+    out() << files.size() << " images in " << corpusDirectory << ", " << size << " px thumbnails, up to "
+          << ThumbnailCache::flavorSize(largestFlavor) << " px cached\n";
+
+    DecodeScheduler* scheduler = DecodeScheduler::instance();
+    bool first = true;
+    for (int threads : threadCounts) {
+        // The scheduler keeps its last CPU slot for the visible image, so thumbnails get cap - 1
+        scheduler->setCpuConcurrency(threads + 1);
+
+        dropThumbnailCache();
+        dropPageCache(files);
+        report(QStringLiteral("cold"), threads, runPass(files, targetSize, largestFlavor));
+        if (first) {
+            // The warm pass is all cache reads; one thread count is enough
+            report(QStringLiteral("warm"), threads, runPass(files, targetSize, largestFlavor));
+            first = false;
+        }
+    }
+    return 0;
+}
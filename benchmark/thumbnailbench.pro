@@ -0,0 +1,36 @@
+# thumbnailbench.pro
+
+# Standalone benchmark for the gallery thumbnail pipeline. Builds the same
+# ThumbnailGenerator/ThumbnailCache/DecodeScheduler sources as imageview, without the UI.
+#   cd benchmark && qmake && make && ./thumbnailbench --help
+
+TARGET = thumbnailbench
+
+TEMPLATE = app
+
+# core/gui: QImage and the image format plugins; concurrent: DecodeScheduler
+QT = core gui concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Benchmark numbers from a debug build are meaningless
+CONFIG += release
+CONFIG -= debug debug_and_release
+
+INCLUDEPATH += $$PWD/..
+
+HEADERS += \
+    ../MappedFile.h \
+    ../ImageHeaderParser.h \
+    ../DecodeScheduler.h \
+    ../ThumbnailCache.h \
+    ../ThumbnailGenerator.h
+
+SOURCES += \
+    ThumbnailBenchmark.cpp \
+    ../MappedFile.cpp \
+    ../ImageHeaderParser.cpp \
+    ../DecodeScheduler.cpp \
+    ../ThumbnailCache.cpp \
+    ../ThumbnailGenerator.cpp
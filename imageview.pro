@@ -26,7 +26,22 @@ HEADERS += \
     ImageApplication.h \
     ImageViewerWidget.h \
     ImageGalleryWidget.h \
-    ImageDataManager.h
+    GalleryModel.h \
+    ImageDataManager.h \
+    ImageCache.h \
+    MappedFile.h \
+    TiledImageSource.h \
+    ImageHeaderParser.h \
+    AnimationPlayer.h \
+    ImageMemoryGovernor.h \
+    DecodeScheduler.h \
+    ThumbnailCache.h \
+    ThumbnailGenerator.h \
+    ThumbnailAtlas.h \
+    LockFreeQueue.h \
+    DirectoryScanner.h \
+    DirectoryWatcher.h \
+    OrthogonalTransform.h
 
 # Input files (sources)
 SOURCES += \
@@ -34,7 +49,31 @@ SOURCES += \
     ImageApplication.cpp \
     ImageViewerWidget.cpp \
     ImageGalleryWidget.cpp \
-    ImageDataManager.cpp
+    GalleryModel.cpp \
+    ImageDataManager.cpp \
+    ImageCache.cpp \
+    MappedFile.cpp \
+    TiledImageSource.cpp \
+    ImageHeaderParser.cpp \
+    AnimationPlayer.cpp \
+    ImageMemoryGovernor.cpp \
+    DecodeScheduler.cpp \
+    ThumbnailCache.cpp \
+    ThumbnailGenerator.cpp \
+    ThumbnailAtlas.cpp \
+    DirectoryScanner.cpp \
+    DirectoryWatcher.cpp \
+    OrthogonalTransform.cpp
+
+# Optional: libtiff enables tiled, viewport-driven decoding of very large TIFF files.
+# Without it such TIFFs (and any other image above 100 MP) are decoded once for the
+# screen - the whole frame, then downscaled, since Qt's TIFF reader cannot scale while
+# decoding - and zooming past 1:1 keeps that reduced image instead of a full decode.
+packagesExist(libtiff-4) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libtiff-4
+    DEFINES += HAVE_LIBTIFF
+}
 
 # Optional: Add resources like icons, stylesheets if you plan to use them.
 # For example, if you have a file called 'app_resources.qrc':
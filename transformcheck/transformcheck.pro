@@ -0,0 +1,24 @@
+# transformcheck.pro
+
+# Standalone correctness check for OrthogonalTransform: compares every
+# rotation/flip combination against a reference permutation and QImage.
+#   cd transformcheck && qmake && make && ./transformcheck
+
+TARGET = transformcheck
+
+TEMPLATE = app
+
+# gui: QImage; concurrent: the kernel's banded path for large images
+QT = core gui concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/..
+
+HEADERS += \
+    ../OrthogonalTransform.h
+
+SOURCES += \
+    TransformCheck.cpp \
+    ../OrthogonalTransform.cpp